@@ -5,128 +5,374 @@
 #include "anneal.hh"
 #include "entity.hh"
 #include "moveSet.hh"
+#include "parallelTempering.hh"
+#include "stats.hh"
 #include <ctime>
 #include <thread>
-#include <list>
+#include <vector>
 #include <atomic>
+#include <algorithm>
 #include <iostream>
+#include "assert.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using namespace std;
 
-static list<AnnealThread*> allThreads;
+// How often the overall progress is reported while partitions are being annealed
+static const chrono::milliseconds PROGRESS_REPORT_INTERVAL(500);
 
 ///////////////////////////////////////////////////////////////////////////////
-// Global functions
+// Local functions
 
-void anneal_all_partitions(AllTeamData* teamData, AllCostData* allCostData) 
+// Used to sort tasks so that the largest partitions are started first
+static bool larger_task(const AnnealTask* task1, const AnnealTask* task2)
 {
-    int countDonePartitions = 0;
-    int numPartitions = 0;
-    EntityListIterator partitionItr = teamData->get_partition_iterator();
-    // Start all the threads
-    while(!partitionItr.done()) {
-	Partition* partition = (Partition*)partitionItr;
-	cerr << "Starting partition " << partition->get_name() << endl;
-	allThreads.push_back(new AnnealThread(partition, allCostData->get_cost_data_for_partition(partition)));
-	++partitionItr;
-	++numPartitions;
-    }
-    while(!allThreads.empty()) {
-        this_thread::sleep_for(chrono::milliseconds(500));
-        // Iterate over all the threads and see which ones are done. (Progress percent is 100% if done.)
-        int sumPercent = countDonePartitions * 100;
-        list<AnnealThread*>::iterator itr = allThreads.begin();
-        
-        while(itr != allThreads.end()) {
-            int percentProgressThisPartition = (*itr)->get_progress_percent();
-            if(percentProgressThisPartition == 100) {
-                // Partition is done
-                countDonePartitions++;
-                if(numPartitions > 1) {
-                    cerr << "Partition " << (*itr)->get_partition_name() << " is done" << endl;
-                }
-                // Delete the data structure (this joins the thread)
-                delete (*itr);
-                // Remove it from the list 
-                itr = allThreads.erase(itr);
-            } else {
-                itr++;
-            }
-            sumPercent += percentProgressThisPartition;
-        }
-        int percentComplete = sumPercent / numPartitions;
-        cerr << "Percent complete: " << percentComplete << "%" << endl;
+    return task1->size() > task2->size();
+}
+
+// Pin the calling thread to the given CPU core. This is only supported on linux - on other
+// platforms it does nothing.
+static void pin_current_thread_to_core(int core)
+{
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0) {
+	cerr << "Unable to pin worker thread to core " << core << endl;
     }
+#endif
 }
 
-void anneal_all_partitions_single_thread(AllTeamData* teamData, AllCostData* allCostData) 
+// Create a replica of the given partition with its own random initial teams. This is used 
+// for restarts (repeat attempts at annealing the partition)
+static Partition* create_restart_partition(Partition* partition, unsigned int copyNum)
+{
+    Partition* replica = partition->create_replica(copyNum);
+    replica->clear();
+    replica->populate_random_teams();
+    replica->set_current_teams_as_lowest_cost();
+    return replica;
+}
+
+// Given all the attempts at annealing a partition (the first of which is for the partition 
+// itself and the remainder are for replicas), copy the lowest cost teams to the partition. 
+// Replicas are deleted.
+static void keep_lowest_cost_attempt(vector<AnnealTask*>& attempts)
+{
+    Partition* partition = attempts[0]->get_partition();
+    CostData* costData = attempts[0]->get_cost_data();
+    unsigned int best = 0;
+    for(unsigned int i = 1; i < attempts.size(); ++i) {
+	if(attempts[i]->get_cost_data()->get_cost_value() < 
+		attempts[best]->get_cost_data()->get_cost_value()) {
+	    best = i;
+	}
+    }
+    if(best != 0) {
+	partition->copy_teams_from(attempts[best]->get_partition());
+	partition->set_current_teams_as_lowest_cost();
+	costData->initialise_constraint_costs();
+    }
+    if(attempts.size() > 1) {
+	cerr << "Partition " << partition->get_name() << ": lowest cost from attempt " 
+		<< (best + 1) << " of " << attempts.size() << endl;
+    }
+    for(unsigned int i = 1; i < attempts.size(); ++i) {
+	delete attempts[i]->get_cost_data();
+	delete attempts[i]->get_partition();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Global functions
+
+void anneal_all_partitions(AllTeamData* teamData, AllCostData* allCostData, 
+	const AnnealOptions& options) 
 {
-    int countDonePartitions = 0;
     int numPartitions = teamData->num_partitions();
+    int numRestarts = options.numRestarts;
+    // Tasks for each partition - one per attempt. The first attempt anneals the partition 
+    // itself, others anneal replicas with their own random initial teams.
+    vector<vector<AnnealTask*> > allTasks(numPartitions);
+    vector<bool> reportedDone(numPartitions, false);
+    AnnealWorkerPool pool(min(options.num_worker_threads(), numPartitions * numRestarts), 
+	    options.pinThreads);
+
+    // Create the tasks for each partition
     EntityListIterator partitionItr = teamData->get_partition_iterator();
-    // Start all the threads
-    while(!partitionItr.done()) {
+    for(int i = 0; i < numPartitions; ++i, ++partitionItr) {
 	Partition* partition = (Partition*)partitionItr;
 	CostData* costData = allCostData->get_cost_data_for_partition(partition);
-	AnnealThread* thread = new AnnealThread(partition, costData);
-	cerr << "Starting partition " << thread->get_partition_name() << endl;
-	while(true) {
-	    this_thread::sleep_for(chrono::milliseconds(500));
-	    int sumPercent = countDonePartitions * 100;
-	    int percentProgressThisPartition = thread->get_progress_percent();
-	    if(percentProgressThisPartition == 100) {
-		// Partition is done
-		countDonePartitions++;
-		if(numPartitions > 1) {
-		    cerr << "Partition " << thread->get_partition_name() << " is done" << endl;
-		}
-		// Delete the data structure (this joins the thread)
-		delete thread;
-		break;
+	for(int attempt = 0; attempt < numRestarts; ++attempt) {
+	    AnnealTask* task;
+	    if(attempt == 0) {
+		task = new AnnealTask(partition, costData, options, attempt);
+	    } else {
+		// Each attempt uses numReplicas copies of the partition (for parallel tempering)
+		Partition* replica = create_restart_partition(partition, 
+			attempt * options.numReplicas);
+		task = new AnnealTask(replica, new CostData(costData->annealInfo, replica), 
+			options, attempt);
 	    }
+	    allTasks[i].push_back(task);
+	    pool.add_task(task);
+	}
+    }
+    pool.start();
 
-	    sumPercent += percentProgressThisPartition;
+    // We're woken as soon as a task finishes (so that we don't hold up small jobs) and otherwise
+    // at each progress report
+    int countDonePartitions = 0;
+    int numTasksFinished = 0;
+    chrono::steady_clock::time_point nextReportTime = 
+	    chrono::steady_clock::now() + PROGRESS_REPORT_INTERVAL;
+    while(countDonePartitions < numPartitions) {
+	numTasksFinished = pool.wait_for_finished_tasks(numTasksFinished, nextReportTime);
+        // Iterate over all the tasks and see which ones are done
+        int sumPercent = 0;
+	for(int i = 0; i < numPartitions; ++i) {
+	    int percentProgressThisPartition = 0;
+	    bool allAttemptsFinished = true;
+	    for(int attempt = 0; attempt < numRestarts; ++attempt) {
+		percentProgressThisPartition += allTasks[i][attempt]->get_progress_percent();
+		if(!allTasks[i][attempt]->is_finished()) {
+		    allAttemptsFinished = false;
+		}
+	    }
+	    percentProgressThisPartition /= numRestarts;
+            if(allAttemptsFinished && !reportedDone[i]) {
+                // Partition is done
+                countDonePartitions++;
+		reportedDone[i] = true;
+                if(numPartitions > 1) {
+                    cerr << "Partition " << allTasks[i][0]->get_partition_name() << " is done" << endl;
+                }
+	    }
+            sumPercent += percentProgressThisPartition;
+        }
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if(now >= nextReportTime || countDonePartitions == numPartitions) {
 	    int percentComplete = sumPercent / numPartitions;
 	    cerr << "Percent complete: " << percentComplete << "%" << endl;
+	    nextReportTime = now + PROGRESS_REPORT_INTERVAL;
+	}
+    }
+    // All tasks are done - reclaim the worker threads
+    pool.join();
+    for(int i = 0; i < numPartitions; ++i) {
+	// Record move statistics over all attempts
+	MoveSet::MoveStats moveStats;
+	for(int attempt = 0; attempt < numRestarts; ++attempt) {
+	    MoveSet::add_move_stats(moveStats, allTasks[i][attempt]->get_move_stats());
 	}
+	stats_add_move_stats(allTasks[i][0]->get_partition(), moveStats);
 
-	++partitionItr;
+	keep_lowest_cost_attempt(allTasks[i]);
+	for(int attempt = 0; attempt < numRestarts; ++attempt) {
+	    delete allTasks[i][attempt];
+	}
     }
 }
 
+// Anneal each partition in turn using just one worker thread (other options are as given)
+void anneal_all_partitions_single_thread(AllTeamData* teamData, AllCostData* allCostData,
+	const AnnealOptions& options) 
+{
+    AnnealOptions singleThreadOptions(options);
+    singleThreadOptions.numJobs = 1;
+    anneal_all_partitions(teamData, allCostData, singleThreadOptions);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
-// Local functions
+// AnnealOptions
+
+// Constructor
+AnnealOptions::AnnealOptions() :
+	numJobs(0),
+	pinThreads(false),
+	numReplicas(1),
+	numRestarts(1),
+	costGuidedSwaps(false),
+	timeLimit(0.0),
+	maxMoves(0),
+	targetCost(-1.0),
+	startTime(AnnealBudget::Clock::now())
+{
+}
+
+int AnnealOptions::num_worker_threads() const
+{
+    if(numJobs > 0) {
+	return numJobs;
+    }
+    // hardware_concurrency() returns 0 if the value can't be determined
+    int numCores = thread::hardware_concurrency();
+    return max(numCores, 1);
+}
+
+AnnealBudget AnnealOptions::create_budget() const
+{
+    chrono::duration<double> limit(timeLimit);
+    return AnnealBudget(timeLimit > 0.0, 
+	    startTime + chrono::duration_cast<AnnealBudget::Clock::duration>(limit), 
+	    maxMoves, targetCost);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
-// AnnealThread
+// AnnealTask
 
 // Constructor
-AnnealThread::AnnealThread(Partition* partition, CostData* costData) :
+AnnealTask::AnnealTask(Partition* partition, CostData* costData, const AnnealOptions& options,
+		unsigned int attemptNum) :
 	partition(partition),
-	progressPercent(0)
+	costData(costData),
+	options(options),
+	attemptNum(attemptNum),
+	progressPercent(0),
+	finished(false)
 {
-    moveSet = new MoveSet(partition, costData);
-    annealThread = thread(&MoveSet::do_anneal, moveSet, this);
 }
 
-// Destructor
-AnnealThread::~AnnealThread()
+void AnnealTask::run()
 {
-    // Thread should be done - we join it to reclaim resources
-    annealThread.join();
-    delete moveSet;
+    budget = options.create_budget();
+    if(options.numRestarts > 1) {
+	cerr << "Starting partition " << get_partition_name() << " (attempt " << (attemptNum + 1) 
+		<< ")" << endl;
+    } else {
+	cerr << "Starting partition " << get_partition_name() << endl;
+    }
+    if(options.numReplicas > 1) {
+	ParallelTempering* parallelTempering = new ParallelTempering(partition, costData, 
+		options.numReplicas, attemptNum * options.numReplicas, options.costGuidedSwaps);
+	parallelTempering->do_anneal(this);
+	parallelTempering->add_move_stats(moveStats);
+	delete parallelTempering;
+    } else {
+	MoveSet* moveSet = new MoveSet(partition, costData, attemptNum * options.numReplicas);
+	moveSet->set_cost_guided_swaps(options.costGuidedSwaps);
+	moveSet->do_anneal(this, options.cooling);
+	moveSet->add_move_stats(moveStats);
+	delete moveSet;
+    }
+    progressPercent = 100;
+    finished = true;
 }
 
-void AnnealThread::update_progress(unsigned char percent)
+void AnnealTask::update_progress(unsigned char percent)
 {
     progressPercent = percent;
 }
 
-unsigned char AnnealThread::get_progress_percent()
+const AnnealBudget& AnnealTask::get_budget() const
+{
+    return budget;
+}
+
+unsigned char AnnealTask::get_progress_percent()
 {
     return progressPercent;
 }
 
-const string& AnnealThread::get_partition_name()
+bool AnnealTask::is_finished() const
+{
+    return finished;
+}
+
+const string& AnnealTask::get_partition_name()
 {
     return partition->get_name();
 }
+
+Partition* AnnealTask::get_partition() const
+{
+    return partition;
+}
+
+CostData* AnnealTask::get_cost_data() const
+{
+    return costData;
+}
+
+const MoveSet::MoveStats& AnnealTask::get_move_stats() const
+{
+    return moveStats;
+}
+
+int AnnealTask::size() const
+{
+    return partition->num_members();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AnnealWorkerPool
+
+// Constructor
+AnnealWorkerPool::AnnealWorkerPool(int numWorkers, bool pinThreads) :
+	nextTask(0),
+	numWorkers(max(numWorkers, 1)),
+	pinThreads(pinThreads),
+	numTasksFinished(0)
+{
+}
+
+void AnnealWorkerPool::add_task(AnnealTask* task)
+{
+    assert(workers.empty());	// can't add tasks once started
+    tasks.push_back(task);
+}
+
+void AnnealWorkerPool::start()
+{
+    // Largest partitions first so that the longest running task doesn't start last.
+    // (stable sort so equal sized partitions are started in their original order)
+    stable_sort(tasks.begin(), tasks.end(), larger_task);
+    for(int i = 0; i < numWorkers; ++i) {
+	workers.push_back(thread(&AnnealWorkerPool::worker_loop, this, i));
+    }
+}
+
+int AnnealWorkerPool::wait_for_finished_tasks(int numFinishedBefore, 
+	chrono::steady_clock::time_point until)
+{
+    unique_lock<mutex> lock(finishedMutex);
+    while(numTasksFinished <= numFinishedBefore) {
+	if(taskFinished.wait_until(lock, until) == cv_status::timeout) {
+	    break;
+	}
+    }
+    return numTasksFinished;
+}
+
+void AnnealWorkerPool::join()
+{
+    for(unsigned int i = 0; i < workers.size(); ++i) {
+	workers[i].join();
+    }
+    workers.clear();
+}
+
+void AnnealWorkerPool::worker_loop(int workerNum)
+{
+    if(pinThreads) {
+	int numCores = max((int)thread::hardware_concurrency(), 1);
+	pin_current_thread_to_core(workerNum % numCores);
+    }
+    // Keep taking the next unstarted task until there are none left
+    while(true) {
+	unsigned int taskNum = nextTask++;
+	if(taskNum >= tasks.size()) {
+	    break;
+	}
+	tasks[taskNum]->run();
+	{
+	    lock_guard<mutex> lock(finishedMutex);
+	    ++numTasksFinished;
+	}
+	taskFinished.notify_all();
+    }
+}
@@ -8,30 +8,108 @@
 #include "teamData.hh"
 #include "cost.hh"
 #include "moveSet.hh"
+#include "coolingSchedule.hh"
+#include "annealBudget.hh"
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// AnnealOptions
+
+// Settings (from the command line) which control how the anneal is carried out
+class AnnealOptions {
+public:
+    int numJobs;		// Maximum number of worker threads (0 means use the hardware concurrency)
+    bool pinThreads;		// If true, each worker thread is pinned to a CPU core
+    int numReplicas;		// If more than 1, each partition is annealed by parallel tempering
+    				// with this many replicas (each in its own thread)
+    int numRestarts;		// Number of times each partition is annealed (from different
+    				// random initial teams) - the lowest cost result is kept
+    bool costGuidedSwaps;	// If true, swaps are more likely to involve members of teams
+    				// whose constraints have high costs
+    CoolingOptions cooling;	// Cooling schedule (not used by parallel tempering)
+    double timeLimit;		// Seconds (from startTime) after which annealing stops (0 if none)
+    long long maxMoves;		// Maximum number of moves in each anneal of a partition (0 if none)
+    double targetCost;		// The anneal of a partition stops when its cost is no more than
+    				// this (negative if none)
+    AnnealBudget::Clock::time_point startTime;	// when the options were created
+
+    // Constructor - sets default values
+    AnnealOptions();
+
+    // Number of worker threads to use - never less than 1
+    int num_worker_threads() const;
+    // Budget for an anneal of a partition starting now
+    AnnealBudget create_budget() const;
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global function
 
-void anneal_all_partitions(AllTeamData* teamData, AllCostData* allCostData);
-void anneal_all_partitions_single_thread(AllTeamData* teamData, AllCostData* allCostData);
+void anneal_all_partitions(AllTeamData* teamData, AllCostData* allCostData, 
+	const AnnealOptions& options);
+void anneal_all_partitions_single_thread(AllTeamData* teamData, AllCostData* allCostData,
+	const AnnealOptions& options);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Classes
 
-class AnnealThread {
+// The anneal of one partition. This is run by one of the worker threads in the pool.
+class AnnealTask {
 private:
     Partition* partition;
-    MoveSet* moveSet;
-    thread annealThread;
+    CostData* costData;
+    const AnnealOptions& options;
+    unsigned int attemptNum;		// 0 for the first attempt at annealing this partition
     atomic_uchar progressPercent;	// 0 to 100
+    atomic_bool finished;		// set when run() has completed
+    AnnealBudget budget;		// set when the anneal starts
+    MoveSet::MoveStats moveStats;	// statistics for each move type (available after run())
 public:
-    AnnealThread(Partition* partition, CostData* costData);
-    ~AnnealThread();
+    AnnealTask(Partition* partition, CostData* costData, const AnnealOptions& options,
+	    unsigned int attemptNum);
+    void run();		// Do the anneal (in the calling thread)
     void update_progress(unsigned char percent);
+    const AnnealBudget& get_budget() const;
     unsigned char get_progress_percent();
+    bool is_finished() const;
     const string& get_partition_name();
+    Partition* get_partition() const;
+    CostData* get_cost_data() const;
+    const MoveSet::MoveStats& get_move_stats() const;
+    int size() const;	// Number of members in the partition
+};
+
+// Fixed size pool of worker threads. Tasks are sorted largest first and each worker takes
+// the next unstarted task from the shared queue as soon as it becomes free.
+class AnnealWorkerPool {
+private:
+    vector<AnnealTask*> tasks;
+    atomic_uint nextTask;	// index into tasks of the next task to be started
+    vector<thread> workers;
+    int numWorkers;
+    bool pinThreads;
+    // Number of tasks which have finished - waiters are notified each time a task finishes
+    int numTasksFinished;
+    mutex finishedMutex;
+    condition_variable taskFinished;
+
+    void worker_loop(int workerNum);
+public:
+    // Constructor
+    AnnealWorkerPool(int numWorkers, bool pinThreads);
+
+    // Tasks must all be added before start() is called
+    void add_task(AnnealTask* task);
+    void start();
+    // Wait until more than the given number of tasks have finished or the given time is
+    // reached (whichever is first). Returns the number of tasks finished.
+    int wait_for_finished_tasks(int numFinishedBefore, chrono::steady_clock::time_point until);
+    void join();	// Wait for all the workers to finish
 };
 
 #endif
@@ -0,0 +1,75 @@
+//
+// annealBudget.cpp
+//
+
+#include "annealBudget.hh"
+#include <atomic>
+#include <algorithm>
+
+// Lock free so that it can be set from a signal handler
+static atomic<bool> stopRequested(false);
+
+void request_anneal_stop()
+{
+    stopRequested = true;
+}
+
+bool anneal_stop_requested()
+{
+    return stopRequested;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AnnealBudget
+
+// Constructor
+AnnealBudget::AnnealBudget() :
+	startTime(Clock::now()),
+	hasDeadline(false),
+	maxMoves(0),
+	targetCost(-1.0)
+{
+}
+
+// Constructor
+AnnealBudget::AnnealBudget(bool hasDeadline, Clock::time_point deadline, long long maxMoves, 
+		double targetCost) :
+	startTime(Clock::now()),
+	deadline(deadline),
+	hasDeadline(hasDeadline),
+	maxMoves(maxMoves),
+	targetCost(targetCost)
+{
+}
+
+bool AnnealBudget::is_limited() const
+{
+    return hasDeadline || maxMoves > 0;
+}
+
+bool AnnealBudget::should_stop(long long numMoves, double cost) const
+{
+    return stopRequested || 
+	    (maxMoves > 0 && numMoves >= maxMoves) ||
+	    (targetCost >= 0.0 && cost <= targetCost) ||
+	    (hasDeadline && Clock::now() >= deadline);
+}
+
+double AnnealBudget::fraction_used(long long numMoves) const
+{
+    double fraction = -1.0;
+    if(maxMoves > 0) {
+	fraction = (double)numMoves / maxMoves;
+    }
+    if(hasDeadline) {
+	Clock::time_point now = Clock::now();
+	if(now >= deadline) {
+	    fraction = 1.0;
+	} else {
+	    chrono::duration<double> used = now - startTime;
+	    chrono::duration<double> available = deadline - startTime;
+	    fraction = max(fraction, used.count() / available.count());
+	}
+    }
+    return min(fraction, 1.0);
+}
@@ -0,0 +1,49 @@
+//
+// annealBudget.hh
+//
+
+#ifndef ANNEALBUDGET_HH
+#define ANNEALBUDGET_HH
+
+#include <chrono>
+
+using namespace std;
+
+// Ask all anneals to stop as soon as possible (keeping the lowest cost teams found so far).
+// This is safe to call from a signal handler.
+void request_anneal_stop();
+bool anneal_stop_requested();
+
+///////////////////////////////////////////////////////////////////////////////
+// AnnealBudget
+//
+// Limits on the anneal of a partition - a deadline, a maximum number of moves and/or a cost
+// which is good enough. An anneal stops when any limit is reached (or a stop is requested).
+// Cooling schedules are fitted to the time and move limits (whichever will run out first).
+
+class AnnealBudget {
+public:
+    typedef chrono::steady_clock Clock;
+private:
+    Clock::time_point startTime;	// when the anneal started
+    Clock::time_point deadline;
+    bool hasDeadline;
+    long long maxMoves;			// 0 if unlimited
+    double targetCost;			// negative if none
+public:
+    // Constructor - no limits
+    AnnealBudget();
+    // Constructor. The anneal starts now.
+    AnnealBudget(bool hasDeadline, Clock::time_point deadline, long long maxMoves, 
+	    double targetCost);
+
+    // True if the time or number of moves is limited
+    bool is_limited() const;
+    // True if the anneal should stop after the given number of moves (at the given cost)
+    bool should_stop(long long numMoves, double cost) const;
+    // Fraction (0 to 1) of the time or move limit used (whichever is greater). Negative if
+    // neither is limited.
+    double fraction_used(long long numMoves) const;
+};
+
+#endif
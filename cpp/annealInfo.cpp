@@ -62,6 +62,8 @@ vector<const Person*>& AnnealInfo::all_people()
 
 void AnnealInfo::add_person(const Person* person)
 {
+    // Attribute values are indexed by person number so people must be added in order
+    assert(person->get_number() == (int)allPeople.size());
     allPeople.push_back(person);
 }
 
@@ -166,6 +168,16 @@ void AnnealInfo::set_team_name_field(const string& fieldName)
     teamNameField = fieldName;
 }
 
+const CoolingOptions& AnnealInfo::get_cooling_options() const
+{
+    return coolingOptions;
+}
+
+void AnnealInfo::set_cooling_options(const CoolingOptions& options)
+{
+    coolingOptions = options;
+}
+
 /*
 Attribute* AnnealInfo::get_partition_field()
 {
@@ -9,6 +9,7 @@
 #include "attribute.hh"
 #include "person.hh"
 #include "level.hh"
+#include "coolingSchedule.hh"
 #include <vector>
 #include <string>
 
@@ -25,6 +26,7 @@ private:
     vector<Level*> 		allLevels;
     string 			teamNameField;
     string 			teamNameFormat;
+    CoolingOptions		coolingOptions;		// from the constraint file
 
 public:
     // Constructor
@@ -70,6 +72,10 @@ public:
     void set_team_name_format(const string& format);
     void set_team_name_field(const string& fieldName);
 
+    // Cooling functions
+    const CoolingOptions& get_cooling_options() const;
+    void set_cooling_options(const CoolingOptions& options);
+
     // Other functions
     // Update column (attribute) names if we have to output a column which may have the 
     // same name as an existing column then we rename the old column by appending/incrementing
@@ -79,6 +79,23 @@ void Attribute::update_numeric_range_to_include(double d)
     }
 }
 
+void Attribute::set_value_index_for_person(int personNum, int valueIndex)
+{
+    assert(personNum == (int)valueIndexColumn.size());
+    valueIndexColumn.push_back(valueIndex);
+}
+
+void Attribute::set_numeric_value_for_person(int personNum, double value)
+{
+    assert(type == Attribute::NUMERICAL && personNum == (int)numericColumn.size());
+    numericColumn.push_back(value);
+}
+
+bool Attribute::has_value_for_person(int personNum) const
+{
+    return personNum < (int)valueIndexColumn.size();
+}
+
 const string& Attribute::get_name() const
 {
     return name;
@@ -23,6 +23,11 @@ public:
     map<string,int> valueToIndexMap;	
     pair<double,double> numericRange;		// Only valid for numeric constraints
 
+    // Values for each person, stored by column (indexed by person number). Every person has an
+    // index into stringValues; only numeric attributes have numeric values.
+    vector<int> valueIndexColumn;
+    vector<double> numericColumn;
+
     // Constructor
     Attribute(const string& name, Attribute::Type type);
 
@@ -36,6 +41,10 @@ public:
     void update_numeric_range_to_include(double d);	// Update the range to incorporate this value
     						// (numeric constraints only, value must be added 
 						// separately as a string)
+    // Record a person's value (people must be added in person number order)
+    void set_value_index_for_person(int personNum, int valueIndex);
+    void set_numeric_value_for_person(int personNum, double value);
+    bool has_value_for_person(int personNum) const;
     const string& get_name() const;
     const string& get_string_value(unsigned int index) const;
     bool is_string() const;
@@ -0,0 +1,88 @@
+//
+// conditionBitsets.cpp
+//
+
+#include "conditionBitsets.hh"
+#include "teamData.hh"
+#include "assert.h"
+
+// Constructor
+ConditionBitsets::ConditionBitsets(AnnealInfo& annealInfo, const Partition* partition)
+{
+    int numLevels = partition->get_all_team_data()->num_levels();
+    for(int levelNum = 1; levelNum <= numLevels; ++levelNum) {
+	teamRanges[levelNum].resize(partition->num_teams_at_level(levelNum));
+    }
+    int numWords = (partition->num_members() + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    int numConstraints = annealInfo.num_constraints();
+    bitsets.resize(numConstraints);
+    for(int c = 0; c < numConstraints; ++c) {
+	if(annealInfo.get_constraint(c)->is_count_constraint()) {
+	    bitsets[c].resize(numWords, 0);
+	}
+    }
+    add_members(partition, 0);
+}
+
+int ConditionBitsets::add_members(const TeamLevel* team, int position)
+{
+    int start = position;
+    EntityListIterator childItr = team->child_iterator();
+    while(!childItr.done()) {
+	if(childItr->is_member()) {
+	    const Member* member = (const Member*)(Entity*)childItr;
+	    Word bit = (Word)1 << (position % BITS_PER_WORD);
+	    for(unsigned int c = 0; c < bitsets.size(); ++c) {
+		if(!bitsets[c].empty() && member->is_condition_met(c)) {
+		    bitsets[c][position / BITS_PER_WORD] |= bit;
+		}
+	    }
+	    ++position;
+	} else {
+	    position = add_members((const TeamLevel*)(Entity*)childItr, position);
+	}
+	++childItr;
+    }
+    if(!team->is_partition()) {
+	MemberRange& range = teamRanges[team->get_level().get_level_num()][team->get_index()];
+	range.start = start;
+	range.end = position;
+    }
+    return position;
+}
+
+const ConditionBitsets::MemberRange& ConditionBitsets::get_range(const TeamLevel* team) const
+{
+    return teamRanges[team->get_level().get_level_num()][team->get_index()];
+}
+
+int ConditionBitsets::count_members(const TeamLevel* team) const
+{
+    const MemberRange& range = get_range(team);
+    return range.end - range.start;
+}
+
+int ConditionBitsets::count_members_meeting_condition(int constraintNumber, 
+	const TeamLevel* team) const
+{
+    const MemberRange& range = get_range(team);
+    if(range.start == range.end) {
+	return 0;
+    }
+    const vector<Word>& bitset = bitsets[constraintNumber];
+    assert(!bitset.empty());
+    // Mask off the bits before the start and after the end of the range in the first and last
+    // words, then count the set bits a word at a time
+    int firstWord = range.start / BITS_PER_WORD;
+    int lastWord = (range.end - 1) / BITS_PER_WORD;
+    Word firstMask = ~(Word)0 << (range.start % BITS_PER_WORD);
+    Word lastMask = ~(Word)0 >> (BITS_PER_WORD - 1 - (range.end - 1) % BITS_PER_WORD);
+    if(firstWord == lastWord) {
+	return __builtin_popcountll(bitset[firstWord] & firstMask & lastMask);
+    }
+    int count = __builtin_popcountll(bitset[firstWord] & firstMask);
+    for(int w = firstWord + 1; w < lastWord; ++w) {
+	count += __builtin_popcountll(bitset[w]);
+    }
+    return count + __builtin_popcountll(bitset[lastWord] & lastMask);
+}
@@ -0,0 +1,51 @@
+//
+// conditionBitsets.hh
+//
+
+#ifndef CONDITIONBITSETS_HH
+#define CONDITIONBITSETS_HH
+
+#include "annealInfo.hh"
+#include "entity.hh"
+#include "level.hh"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// ConditionBitsets
+//
+// Snapshot of which members meet each count constraint's condition, used to count the members
+// of every team meeting each condition when costs are (re)calculated. Members are numbered in
+// depth first order so that the members of each team (at every level) have contiguous positions
+// and the count for a team is the number of set bits in a range of the constraint's bitset.
+// The snapshot is only valid until the teams change.
+
+class ConditionBitsets {
+private:
+    typedef uint64_t Word;
+    static const int BITS_PER_WORD = 64;
+
+    struct MemberRange {
+	int start;
+	int end;
+    };
+    // Range of member positions for each team (indexed by level number then team index)
+    vector<MemberRange> teamRanges[MAX_LEVELS + 1];
+    // One bitset per constraint, indexed by member position (empty for non-count constraints)
+    vector<vector<Word> > bitsets;
+
+    // Number the members of the given team (starting at the given position) and set their bits.
+    // Returns the position after the team's last member.
+    int add_members(const TeamLevel* team, int position);
+    const MemberRange& get_range(const TeamLevel* team) const;
+public:
+    // Constructor
+    ConditionBitsets(AnnealInfo& annealInfo, const Partition* partition);
+
+    int count_members(const TeamLevel* team) const;
+    int count_members_meeting_condition(int constraintNumber, const TeamLevel* team) const;
+};
+
+#endif
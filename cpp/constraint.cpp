@@ -42,6 +42,11 @@ bool Constraint::applies_to_team_size(int teamSize) const
     return (applicableTeamSize == 0 || teamSize == applicableTeamSize);
 }
 
+bool Constraint::applies_to_all_team_sizes() const
+{
+    return (applicableTeamSize == 0);
+}
+
 bool Constraint::applies_to_string_field() const
 {
     return attribute->is_string();
@@ -53,6 +53,7 @@ public:
     void set_constraint_number(int constraintNum);
     void set_applicable_team_size(int teamSize);
     bool applies_to_team_size(int teamSize) const;
+    bool applies_to_all_team_sizes() const;
     bool applies_to_string_field() const;
     const Attribute* get_attribute() const;
     int get_level() const;
@@ -8,162 +8,404 @@
 #include <cmath>
 
 ///////////////////////////////////////////////////////////////////////////////
-// ConstraintCost
+// ConstraintCostTable
 
 // Constructor
-ConstraintCost::ConstraintCost(const TeamLevel* team, const Constraint* constraint) :
-	team(team),
+ConstraintCostTable::ConstraintCostTable(const Constraint* constraint, const Partition* partition) :
 	constraint(constraint),
-	cost(0.0),
-	costPendingMove(0.0),
-	teamSizePendingMove(team->size())
-{
+	// Only lowest level team sizes change as members move
+	applicabilityMayChange(!constraint->applies_to_all_team_sizes() && 
+		partition->get_all_team_data()->get_level(constraint->get_level()).is_lowest())
+{
+    int numTeams = partition->num_teams_at_level(constraint->get_level());
+    teams.resize(numTeams, nullptr);
+    EntityListIterator teamItr(partition->teams_at_level_iterator(constraint->get_level()));
+    while(!teamItr.done()) {
+	teams[teamItr->get_index()] = (TeamLevel*)teamItr;
+	++teamItr;
+    }
+    cost.assign(numTeams, 0.0);
+    costPendingMove.assign(numTeams, 0.0);
+    teamSizePendingMove.assign(numTeams, 0);
+    pendingEpoch.assign(numTeams, 0);
 }
 
 // Destructor
-ConstraintCost::~ConstraintCost()
+ConstraintCostTable::~ConstraintCostTable()
 {
 }
 
-double ConstraintCost::get_cost()
+void ConstraintCostTable::initialise_all(const ConditionBitsets* conditions)
+{
+    for(unsigned int i = 0; i < teams.size(); ++i) {
+	recalculate(i, conditions);
+    }
+}
+
+const Constraint* ConstraintCostTable::get_constraint() const
 {
-    if(constraint->applies_to_team_size(team->size())) {
-	return cost;
+    return constraint;
+}
+
+int ConstraintCostTable::num_teams() const
+{
+    return teams.size();
+}
+
+const TeamLevel* ConstraintCostTable::get_team(int teamIndex) const
+{
+    return teams[teamIndex];
+}
+
+double ConstraintCostTable::get_cost(int teamIndex) const
+{
+    if(constraint->applies_to_team_size(teams[teamIndex]->size())) {
+	return cost[teamIndex];
     } else {
 	return 0.0;
     }
 }
 
-double ConstraintCost::get_pending_cost()
+double ConstraintCostTable::get_pending_cost(int teamIndex) const
 {
-    if(constraint->applies_to_team_size(teamSizePendingMove)) {
-	return costPendingMove;
+    if(constraint->applies_to_team_size(teamSizePendingMove[teamIndex])) {
+	return costPendingMove[teamIndex];
     } else {
 	return 0.0;
     }
 }
 
-double ConstraintCost::delta_cost()
+CostUnits ConstraintCostTable::get_cost_units(int teamIndex) const
+{
+    return ConstraintCost::to_cost_units(get_cost(teamIndex));
+}
+
+CostUnits ConstraintCostTable::get_pending_cost_units(int teamIndex) const
+{
+    return ConstraintCost::to_cost_units(get_pending_cost(teamIndex));
+}
+
+void ConstraintCostTable::commit_pending(int teamIndex)
+{
+    cost[teamIndex] = costPendingMove[teamIndex];
+    // team size should already have been changed
+    assert(teamSizePendingMove[teamIndex] == teams[teamIndex]->size());
+}
+
+void ConstraintCostTable::undo_pending(int teamIndex)
+{
+    costPendingMove[teamIndex] = cost[teamIndex];
+    teamSizePendingMove[teamIndex] = teams[teamIndex]->size();
+}
+
+void ConstraintCostTable::recalculate(int teamIndex, const ConditionBitsets* conditions)
+{
+    teamSizePendingMove[teamIndex] = teams[teamIndex]->size();
+    initialise(teamIndex, conditions);
+}
+
+double ConstraintCostTable::min_delta_for_member_changes(int teamIndex, int numChanges) const
+{
+    return -get_pending_cost(teamIndex);
+}
+
+void ConstraintCostTable::pend_team_size_change(int teamIndex, int change)
+{
+    if(teams[teamIndex]->get_level().is_lowest()) {
+	teamSizePendingMove[teamIndex] += change;
+    }
+}
+
+ConstraintCostTable* ConstraintCostTable::construct(const Constraint* constraint,
+	const Partition* partition, const ConditionBitsets* conditions)
+{
+    // Choose the class for this type of constraint
+    ConstraintCostTable* table;
+    switch(constraint->get_type()) {
+	case Constraint::COUNT_EXACT:
+	    table = new CountConstraintCostTable<Constraint::COUNT_EXACT>(constraint, partition);
+	    break;
+	case Constraint::COUNT_NOT_EXACT:
+	    table = new CountConstraintCostTable<Constraint::COUNT_NOT_EXACT>(constraint, 
+		    partition);
+	    break;
+	case Constraint::COUNT_AT_LEAST:
+	    table = new CountConstraintCostTable<Constraint::COUNT_AT_LEAST>(constraint, partition);
+	    break;
+	case Constraint::COUNT_AT_MOST:
+	    table = new CountConstraintCostTable<Constraint::COUNT_AT_MOST>(constraint, partition);
+	    break;
+	case Constraint::COUNT_MAXIMISE:
+	    table = new CountConstraintCostTable<Constraint::COUNT_MAXIMISE>(constraint, partition);
+	    break;
+	case Constraint::COUNT_MINIMISE:
+	    table = new CountConstraintCostTable<Constraint::COUNT_MINIMISE>(constraint, partition);
+	    break;
+	case Constraint::HOMOGENEOUS:
+	    if(constraint->applies_to_string_field()) {
+		table = new SimilarityConstraintCostTable<Constraint::HOMOGENEOUS>(constraint, 
+			partition);
+	    } else {
+		table = new RangeConstraintCostTable<Constraint::HOMOGENEOUS>(constraint, 
+			partition);
+	    }
+	    break;
+	case Constraint::HETEROGENEOUS:
+	    if(constraint->applies_to_string_field()) {
+		table = new SimilarityConstraintCostTable<Constraint::HETEROGENEOUS>(constraint,
+			partition);
+	    } else {
+		table = new RangeConstraintCostTable<Constraint::HETEROGENEOUS>(constraint,
+			partition);
+	    }
+	    break;
+	default:
+	    // Shouldn't happen
+	    assert(false);
+	    return nullptr;
+    }
+    table->initialise_all(conditions);
+    return table;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ConstraintCost
+
+// Constructor
+ConstraintCost::ConstraintCost(ConstraintCostTable* table, int teamIndex) :
+	table(table),
+	teamIndex(teamIndex)
+{
+}
+
+double ConstraintCost::get_cost() const
+{
+    return table->get_cost(teamIndex);
+}
+
+double ConstraintCost::get_pending_cost() const
+{
+    return table->get_pending_cost(teamIndex);
+}
+
+double ConstraintCost::delta_cost() const
 {
     return get_pending_cost() - get_cost();
 }
 
+CostUnits ConstraintCost::get_cost_units() const
+{
+    return table->get_cost_units(teamIndex);
+}
+
+CostUnits ConstraintCost::get_pending_cost_units() const
+{
+    return table->get_pending_cost_units(teamIndex);
+}
+
+// 2^20 units per unit of cost - totals up to about 8 x 10^12 can be represented
+static const double COST_UNITS_PER_COST = 1048576.0;
+
+CostUnits ConstraintCost::to_cost_units(double cost)
+{
+    return llround(cost * COST_UNITS_PER_COST);
+}
+
+double ConstraintCost::from_cost_units(CostUnits units)
+{
+    return units / COST_UNITS_PER_COST;
+}
+
+ConstraintCostTable* ConstraintCost::get_table() const
+{
+    return table;
+}
+
+int ConstraintCost::get_team_index() const
+{
+    return teamIndex;
+}
+
 const TeamLevel* ConstraintCost::get_team() const
 {
-    return team;
+    return table->get_team(teamIndex);
 }
 
 const Constraint* ConstraintCost::get_constraint() const
 {
-    return constraint;
+    return table->get_constraint();
 }
 
-ConstraintCost* ConstraintCost::construct(const TeamLevel* team, const Constraint* constraint)
+double ConstraintCost::min_delta_for_member_changes(int numChanges) const
 {
-    if(constraint->is_count_constraint()) {
-	// Count constraint
-	return new CountConstraintCost(team, constraint);
-    } else if (constraint->applies_to_string_field()) {
-	// Must be a similarity constraint
-	return new SimilarityConstraintCost(team, constraint);
-    } else {
-	// Must be a numeric range constraint
-	return new RangeConstraintCost(team, constraint);
-    }
+    return table->min_delta_for_member_changes(teamIndex, numChanges);
 }
 
-void ConstraintCost::commit_pending() 
+double ConstraintCost::percent_constraint_met() const
 {
-    cost = costPendingMove;
-    assert(teamSizePendingMove = team->size());		// team size should already have been changed
+    return table->percent_constraint_met(teamIndex);
 }
 
-void ConstraintCost::undo_pending() 
+// Smallest total of count^1.5 * weight over the given number of teams when the counts add up
+// to the given total. The function is convex so this is when the counts are spread as evenly as
+// possible.
+static CostUnits min_spread_cost_units(int total, int numTeams, double weight)
 {
-    costPendingMove = cost;
-    teamSizePendingMove = team->size();
+    int countPerTeam = total / numTeams;
+    int numTeamsWithExtra = total % numTeams;
+    return numTeamsWithExtra * 
+	    ConstraintCost::to_cost_units(pow(countPerTeam + 1, 1.5) * weight) +
+	    (numTeams - numTeamsWithExtra) * 
+	    ConstraintCost::to_cost_units(pow(countPerTeam, 1.5) * weight);
+}
+
+CostUnits ConstraintCost::lower_bound(const Constraint* constraint, int numTeams, 
+	int numMembers, int numMeetingCondition, int numDistinctValues)
+{
+    // If the constraint only applies to some team sizes, members could be arranged so that it
+    // applies to few (or no) teams
+    if(numTeams <= 0 || !constraint->applies_to_all_team_sizes()) {
+	return 0;
+    }
+    // Number of times the constraint's weight must be charged (count constraints with targets
+    // and similarity constraints)
+    int numWeightsCharged = 0;
+    int target = 0;
+    if(constraint->is_count_constraint()) {
+	target = ((const CountConstraint*)constraint)->get_target();
+    }
+    switch(constraint->get_type()) {
+	case Constraint::COUNT_EXACT:
+	    // Each team meeting the target uses target members - any left over must go to a team
+	    // which doesn't meet it
+	    if(numMeetingCondition < numTeams * target) {
+		numWeightsCharged = numTeams - numMeetingCondition / target;
+	    } else if(numMeetingCondition > numTeams * target) {
+		numWeightsCharged = 1;
+	    }
+	    break;
+	case Constraint::COUNT_NOT_EXACT:
+	    // Only "not exactly 0" (i.e. at least 1) can be bounded
+	    if(target == 0) {
+		numWeightsCharged = max(numTeams - numMeetingCondition, 0);
+	    }
+	    break;
+	case Constraint::COUNT_AT_LEAST:
+	    if(target > 0) {
+		numWeightsCharged = max(numTeams - numMeetingCondition / target, 0);
+	    }
+	    break;
+	case Constraint::COUNT_AT_MOST:
+	    if(target >= 0 && numMeetingCondition > numTeams * target) {
+		numWeightsCharged = 1;
+	    }
+	    break;
+	case Constraint::COUNT_MAXIMISE:
+	    return min_spread_cost_units(numMembers - numMeetingCondition, numTeams, 
+		    constraint->get_weight());
+	case Constraint::COUNT_MINIMISE:
+	    return min_spread_cost_units(numMeetingCondition, numTeams, constraint->get_weight());
+	case Constraint::HOMOGENEOUS:
+	    // Every value is held by at least one team and each team after its first value is
+	    // charged for each extra value. (No bound is known for numeric attributes.)
+	    if(constraint->applies_to_string_field()) {
+		numWeightsCharged = max(numDistinctValues - numTeams, 0);
+	    }
+	    break;
+	default:
+	    break;
+    }
+    return numWeightsCharged * to_cost_units(constraint->get_weight());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// CountConstraintCost
+// CountConstraintCostTable
 
 // Constructor
-CountConstraintCost::CountConstraintCost(const TeamLevel* team, const Constraint* constraint) :
-	ConstraintCost(team, constraint),
+template<Constraint::Type TYPE>
+CountConstraintCostTable<TYPE>::CountConstraintCostTable(const Constraint* constraint,
+	const Partition* partition) :
+	ConstraintCostTable(constraint, partition),
 	target(((const CountConstraint*)constraint)->get_target()),
 	constraintNumber(constraint->get_constraint_number()),
-	numMembersConsidered(0),
-	count(0),
-	numMembersPendingMove(0),
-	countPendingMove(0)
+	numMembersConsidered(teams.size(), 0),
+	count(teams.size(), 0),
+	numMembersPendingMove(teams.size(), 0),
+	countPendingMove(teams.size(), 0)
 {
     // Make sure the constraint is a count constraint
-    assert(constraint->is_count_constraint());
-
-    this->initialise();
-}
-
-// Destructor
-CountConstraintCost::~CountConstraintCost()
-{
+    assert(constraint->is_count_constraint() && constraint->get_type() == TYPE);
 }
 
-// Count how many team members meet the constraint
-void CountConstraintCost::initialise()
+// Count how many team members meet the constraint (taking the counts from the condition bitsets
+// if given rather than visiting every member)
+template<Constraint::Type TYPE>
+void CountConstraintCostTable<TYPE>::initialise(int teamIndex, const ConditionBitsets* conditions)
 {
-    // Iterate over each member of the team and count how many satisfy the condition
-    countPendingMove = 0;
-    numMembersPendingMove = 0;
-    MemberIterator memberItr(team);
-    while(!memberItr.done()) {
-	if(memberItr->is_condition_met(constraintNumber)) {
-	    countPendingMove++;
+    const TeamLevel* team = teams[teamIndex];
+    if(conditions) {
+	countPendingMove[teamIndex] = conditions->count_members_meeting_condition(constraintNumber,
+		team);
+	numMembersPendingMove[teamIndex] = conditions->count_members(team);
+    } else {
+	// Iterate over each member of the team and count how many satisfy the condition
+	countPendingMove[teamIndex] = 0;
+	numMembersPendingMove[teamIndex] = 0;
+	MemberIterator memberItr(team);
+	while(!memberItr.done()) {
+	    if(memberItr->is_condition_met(constraintNumber)) {
+		countPendingMove[teamIndex]++;
+	    }
+	    ++memberItr;
+	    ++numMembersPendingMove[teamIndex];
 	}
-	++memberItr;
-	++numMembersPendingMove;
     }
     // We've saved these as pending changes - commit them
-    evaluate();
-    commit_pending();
+    evaluate(teamIndex);
+    commit_pending(teamIndex);
 }
 
 // Based on the count, work out the new cost
-void CountConstraintCost::evaluate()
+template<Constraint::Type TYPE>
+void CountConstraintCostTable<TYPE>::evaluate(int teamIndex)
 {
-    switch(constraint->get_type()) {
+    int countPending = countPendingMove[teamIndex];
+    double& costPending = costPendingMove[teamIndex];
+    switch(TYPE) {
 	case Constraint::COUNT_EXACT:
-	    if(countPendingMove == target) {
-		costPendingMove = 0.0;
+	    if(countPending == target) {
+		costPending = 0.0;
 	    } else {
-		costPendingMove = constraint->get_weight();
+		costPending = constraint->get_weight();
 	    } 
 	    break;
 	case Constraint::COUNT_NOT_EXACT:
-	    if(countPendingMove != target) {
-		costPendingMove = 0.0;
+	    if(countPending != target) {
+		costPending = 0.0;
 	    } else {
-		costPendingMove = constraint->get_weight();
+		costPending = constraint->get_weight();
 	    }
 	    break;
 	case Constraint::COUNT_AT_LEAST:
-	    if(countPendingMove >= target) {
-		costPendingMove = 0.0;
+	    if(countPending >= target) {
+		costPending = 0.0;
 	    } else {
-		costPendingMove = constraint->get_weight();
+		costPending = constraint->get_weight();
 	    }
 	    break;
 	case Constraint::COUNT_AT_MOST:
-	    if(countPendingMove <= target) {
-		costPendingMove = 0.0;
+	    if(countPending <= target) {
+		costPending = 0.0;
 	    } else {
-		costPendingMove = constraint->get_weight();
+		costPending = constraint->get_weight();
 	    }
 	    break;
 	case Constraint::COUNT_MAXIMISE:
-	    costPendingMove = pow(numMembersPendingMove - countPendingMove, 1.5) * constraint->get_weight();
+	    costPending = pow(numMembersPendingMove[teamIndex] - countPending, 1.5) * 
+		    constraint->get_weight();
 	    break;
 	case Constraint::COUNT_MINIMISE:
-	    costPendingMove = pow(countPendingMove, 1.5) * constraint->get_weight();
+	    costPending = pow(countPending, 1.5) * constraint->get_weight();
 	    break;
 	default:
 	    // Shouldn't happen
@@ -171,73 +413,110 @@ void CountConstraintCost::evaluate()
     }
 }
 
-void CountConstraintCost::commit_pending()
+template<Constraint::Type TYPE>
+void CountConstraintCostTable<TYPE>::commit_pending(int teamIndex)
 {
-    ConstraintCost::commit_pending();
+    ConstraintCostTable::commit_pending(teamIndex);
 
-    count = countPendingMove;
-    numMembersConsidered = numMembersPendingMove;
+    count[teamIndex] = countPendingMove[teamIndex];
+    numMembersConsidered[teamIndex] = numMembersPendingMove[teamIndex];
 }
 
-void CountConstraintCost::undo_pending()
+template<Constraint::Type TYPE>
+void CountConstraintCostTable<TYPE>::undo_pending(int teamIndex)
 {
-    ConstraintCost::undo_pending();
+    ConstraintCostTable::undo_pending(teamIndex);
 
-    countPendingMove = count;
-    numMembersPendingMove = numMembersConsidered;
+    countPendingMove[teamIndex] = count[teamIndex];
+    numMembersPendingMove[teamIndex] = numMembersConsidered[teamIndex];
 }
 
-double CountConstraintCost::pend_remove_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits CountConstraintCostTable<TYPE>::pend_remove_member(int teamIndex, const Member* member)
 {
     // We assume, but do not check that the member is part of the team
-    double costBefore = get_pending_cost();
-    --numMembersPendingMove;
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, -1);
+    --numMembersPendingMove[teamIndex];
     if(member->is_condition_met(constraintNumber)) {
-	--countPendingMove;
+	--countPendingMove[teamIndex];
     }
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double CountConstraintCost::pend_add_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits CountConstraintCostTable<TYPE>::pend_add_member(int teamIndex, const Member* member)
 {
     // We assume, but do not check that the member is not part of the team
-    double costBefore = get_pending_cost();
-    ++numMembersPendingMove;
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, 1);
+    ++numMembersPendingMove[teamIndex];
     if(member->is_condition_met(constraintNumber)) {
-	++countPendingMove;
+	++countPendingMove[teamIndex];
     }
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double CountConstraintCost::percent_constraint_met()
+template<Constraint::Type TYPE>
+double CountConstraintCostTable<TYPE>::min_delta_for_member_changes(int teamIndex, 
+	int numChanges) const
 {
-    assert(costPendingMove == cost);
-    if(!constraint->applies_to_team_size(team->size())) {
+    double pendingCost = get_pending_cost(teamIndex);
+    if(pendingCost == 0.0 || applicabilityMayChange) {
+	return -pendingCost;
+    }
+    // The count (and the number of members not meeting the condition) can change by at most
+    // the number of changes
+    int countPending = countPendingMove[teamIndex];
+    switch(TYPE) {
+	case Constraint::COUNT_EXACT:
+	    return (abs(countPending - target) <= numChanges) ? -pendingCost : 0.0;
+	case Constraint::COUNT_AT_LEAST:
+	    return (countPending + numChanges >= target) ? -pendingCost : 0.0;
+	case Constraint::COUNT_AT_MOST:
+	    return (countPending - numChanges <= target) ? -pendingCost : 0.0;
+	case Constraint::COUNT_MAXIMISE:
+	    return pow(max(numMembersPendingMove[teamIndex] - countPending - numChanges, 0), 1.5) *
+		    constraint->get_weight() - pendingCost;
+	case Constraint::COUNT_MINIMISE:
+	    return pow(max(countPending - numChanges, 0), 1.5) * constraint->get_weight() - 
+		    pendingCost;
+	default:
+	    return -pendingCost;
+    }
+}
+
+template<Constraint::Type TYPE>
+double CountConstraintCostTable<TYPE>::percent_constraint_met(int teamIndex) const
+{
+    assert(costPendingMove[teamIndex] == cost[teamIndex]);
+    if(!constraint->applies_to_team_size(teams[teamIndex]->size())) {
 	return 100.0;	// constraints are assumed to be met if they do not apply to this team size
     }
-    switch(constraint->get_type()) {
+    switch(TYPE) {
 	case Constraint::COUNT_EXACT:
 	case Constraint::COUNT_NOT_EXACT:
 	case Constraint::COUNT_AT_LEAST:
 	case Constraint::COUNT_AT_MOST:
-	    if(cost == 0.0) {
+	    if(cost[teamIndex] == 0.0) {
 		return 100.0;
 	    } else {
 		return 0;
 	    }
 	    break;
 	case Constraint::COUNT_MAXIMISE:
-	    if(numMembersConsidered > 0) {
-		return (100.0*(double)count/(double)numMembersConsidered);
+	    if(numMembersConsidered[teamIndex] > 0) {
+		return (100.0*(double)count[teamIndex]/(double)numMembersConsidered[teamIndex]);
 	    } else {
 		return 100.0;
 	    }
 	    break;
 	case Constraint::COUNT_MINIMISE:
-	    if(numMembersConsidered > 0) {
-		return 100.0 - (100.0*(double)count/(double)numMembersConsidered);
+	    if(numMembersConsidered[teamIndex] > 0) {
+		return 100.0 - 
+			(100.0*(double)count[teamIndex]/(double)numMembersConsidered[teamIndex]);
 	    } else {
 		return 100.0;
 	    }
@@ -245,78 +524,79 @@ double CountConstraintCost::percent_constraint_met()
 	default:
 	    // Shouldn't happen
 	    assert(false);
+	    return 100.0;
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// SimilarityConstraintCost
+// SimilarityConstraintCostTable
 
 // Constructor
-SimilarityConstraintCost::SimilarityConstraintCost(const TeamLevel* team, const Constraint* constraint) :
-	ConstraintCost(team, constraint),
+template<Constraint::Type TYPE>
+SimilarityConstraintCostTable<TYPE>::SimilarityConstraintCostTable(const Constraint* constraint,
+	const Partition* partition) :
+	ConstraintCostTable(constraint, partition),
 	attribute(constraint->get_attribute()),
 	numAttributeValues(constraint->get_attribute()->num_values()),
-	countDistinctValues(0),
-	numMembersConsidered(0),
-	countDistinctValuesPendingMove(0),
-	numMembersPendingMove(0)
-{
-    assert(attribute->is_string());
-
-    this->initialise();
-}
-
-// Destructor
-SimilarityConstraintCost::~SimilarityConstraintCost()
-{
-}
-
-void SimilarityConstraintCost::initialise()
-{
-    // This initialiser updates both the committed and pending values - it's easier that way
-    // Clear the map of values to counts
-    valueCount.clear();
-    valueCountPendingMove.clear();
-    // Create an entry for each possible attribute value and initialise the count to 0 for each
-    valueCount.resize(numAttributeValues, 0);
-    valueCountPendingMove.resize(numAttributeValues, 0);
-    countDistinctValuesPendingMove = 0;
-    numMembersPendingMove = 0;
-
-    // Iterate over each member of the team and work out how many different values there are
-    MemberIterator memberItr(team);
+	valueCount(teams.size()),
+	countDistinctValues(teams.size(), 0),
+	numMembersConsidered(teams.size(), 0),
+	valueCountPendingMove(teams.size()),
+	valueCountsToUpdate(teams.size()),
+	countDistinctValuesPendingMove(teams.size(), 0),
+	numMembersPendingMove(teams.size(), 0)
+{
+    assert(attribute->is_string() && constraint->get_type() == TYPE);
+}
+
+template<Constraint::Type TYPE>
+void SimilarityConstraintCostTable<TYPE>::initialise(int teamIndex, 
+	const ConditionBitsets* conditions)
+{
+    // This initialiser updates both the committed and pending values - it's easier that way.
+    // Find the value of each member first - the number of members determines how the counts
+    // are stored.
+    vector<int> memberValues;
+    MemberIterator memberItr(teams[teamIndex]);
     while(!memberItr.done()) {
-	int attributeValueIndex = memberItr->get_attribute_value_index(attribute);
-	++valueCount[attributeValueIndex];
-	++valueCountPendingMove[attributeValueIndex];
-	if(valueCount[attributeValueIndex] == 1) {
-	    ++countDistinctValuesPendingMove;
-	}
-	++numMembersPendingMove;
-
-	// Move on to next member
+	memberValues.push_back(memberItr->get_attribute_value_index(attribute));
 	++memberItr;
     }
-    valueCountsToUpdate.clear();
-    this->evaluate();
-    this->commit_pending();
+    valueCount[teamIndex].reset(numAttributeValues, memberValues.size());
+    valueCountPendingMove[teamIndex].reset(numAttributeValues, memberValues.size());
+    countDistinctValuesPendingMove[teamIndex] = 0;
+    numMembersPendingMove[teamIndex] = memberValues.size();
+
+    // Work out how many different values there are
+    for(unsigned int i = 0; i < memberValues.size(); ++i) {
+	valueCountPendingMove[teamIndex].increment(memberValues[i]);
+	if(valueCount[teamIndex].increment(memberValues[i]) == 1) {
+	    ++countDistinctValuesPendingMove[teamIndex];
+	}
+    }
+    valueCountsToUpdate[teamIndex].clear();
+    evaluate(teamIndex);
+    commit_pending(teamIndex);
 }
 
-void SimilarityConstraintCost::evaluate()
+template<Constraint::Type TYPE>
+void SimilarityConstraintCostTable<TYPE>::evaluate(int teamIndex)
 {
+    int countDistinct = countDistinctValuesPendingMove[teamIndex];
     int maxPossibleValues;
 
-    switch(constraint->get_type()) {
+    switch(TYPE) {
 	case Constraint::HOMOGENEOUS:
-	    if(countDistinctValuesPendingMove <= 1) {
-		costPendingMove = 0.0;
+	    if(countDistinct <= 1) {
+		costPendingMove[teamIndex] = 0.0;
 	    } else {
-		costPendingMove = (countDistinctValuesPendingMove - 1) * constraint->get_weight();
+		costPendingMove[teamIndex] = (countDistinct - 1) * constraint->get_weight();
 	    }
 	    break;
 	case Constraint::HETEROGENEOUS:
-	    maxPossibleValues = min(numMembersPendingMove, numAttributeValues);
-	    costPendingMove = (maxPossibleValues - countDistinctValuesPendingMove) * constraint->get_weight();
+	    maxPossibleValues = min(numMembersPendingMove[teamIndex], numAttributeValues);
+	    costPendingMove[teamIndex] = (maxPossibleValues - countDistinct) * 
+		    constraint->get_weight();
 	    break;
 	default:
 	    assert(false);	// Should not happen
@@ -324,170 +604,189 @@ void SimilarityConstraintCost::evaluate()
     }
 }
 
-void SimilarityConstraintCost::commit_pending()
+template<Constraint::Type TYPE>
+void SimilarityConstraintCostTable<TYPE>::commit_pending(int teamIndex)
 {
-    ConstraintCost::commit_pending();
+    ConstraintCostTable::commit_pending(teamIndex);
 
-    countDistinctValues = countDistinctValuesPendingMove;
-    numMembersConsidered = numMembersPendingMove;
-    for(unsigned int i=0; i< valueCountsToUpdate.size(); ++i) {
-	valueCount[valueCountsToUpdate[i]] = valueCountPendingMove[valueCountsToUpdate[i]];
+    countDistinctValues[teamIndex] = countDistinctValuesPendingMove[teamIndex];
+    numMembersConsidered[teamIndex] = numMembersPendingMove[teamIndex];
+    vector<int>& valuesToUpdate = valueCountsToUpdate[teamIndex];
+    for(unsigned int i=0; i< valuesToUpdate.size(); ++i) {
+	valueCount[teamIndex].set(valuesToUpdate[i], 
+		valueCountPendingMove[teamIndex].get(valuesToUpdate[i]));
     }
-    valueCountsToUpdate.clear();
+    valuesToUpdate.clear();
 }
 
-void SimilarityConstraintCost::undo_pending()
+template<Constraint::Type TYPE>
+void SimilarityConstraintCostTable<TYPE>::undo_pending(int teamIndex)
 {
-    ConstraintCost::undo_pending();
+    ConstraintCostTable::undo_pending(teamIndex);
 
-    countDistinctValuesPendingMove = countDistinctValues;
-    numMembersPendingMove = numMembersConsidered;
-    for(unsigned int i=0; i< valueCountsToUpdate.size(); ++i) {
-	valueCountPendingMove[valueCountsToUpdate[i]] = valueCount[valueCountsToUpdate[i]];
+    countDistinctValuesPendingMove[teamIndex] = countDistinctValues[teamIndex];
+    numMembersPendingMove[teamIndex] = numMembersConsidered[teamIndex];
+    vector<int>& valuesToUpdate = valueCountsToUpdate[teamIndex];
+    for(unsigned int i=0; i< valuesToUpdate.size(); ++i) {
+	valueCountPendingMove[teamIndex].set(valuesToUpdate[i], 
+		valueCount[teamIndex].get(valuesToUpdate[i]));
     }
-    valueCountsToUpdate.clear();
+    valuesToUpdate.clear();
 }
 
-double SimilarityConstraintCost::pend_remove_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits SimilarityConstraintCostTable<TYPE>::pend_remove_member(int teamIndex, 
+	const Member* member)
 {
     // We assume, but do not check that the member is part of the team
-    double costBefore = get_pending_cost();
-    --numMembersPendingMove;		// removing members - reduce our member count
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, -1);
+    --numMembersPendingMove[teamIndex];	// removing members - reduce our member count
 
     int attributeValueIndex = member->get_attribute_value_index(attribute);
-    assert(valueCountPendingMove[attributeValueIndex] > 0);
-    --valueCountPendingMove[attributeValueIndex];
-    valueCountsToUpdate.push_back(attributeValueIndex);	// add this index to our list of indices to 
-    							// update if we commit this change
-    if(valueCountPendingMove[attributeValueIndex] == 0) {
+    int newCount = valueCountPendingMove[teamIndex].decrement(attributeValueIndex);
+    assert(newCount >= 0);
+    // add this index to our list of indices to update if we commit this change
+    valueCountsToUpdate[teamIndex].push_back(attributeValueIndex);
+    if(newCount == 0) {
 	// One fewer distinct value now
-	assert(countDistinctValuesPendingMove > 0);
-	--countDistinctValuesPendingMove;
+	assert(countDistinctValuesPendingMove[teamIndex] > 0);
+	--countDistinctValuesPendingMove[teamIndex];
     }
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double SimilarityConstraintCost::pend_add_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits SimilarityConstraintCostTable<TYPE>::pend_add_member(int teamIndex, 
+	const Member* member)
 {
     // We assume, but do not check that the member is not part of the team
-    double costBefore = get_pending_cost();
-    ++numMembersPendingMove;
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, 1);
+    ++numMembersPendingMove[teamIndex];
 
     int attributeValueIndex = member->get_attribute_value_index(attribute);
-    ++valueCountPendingMove[attributeValueIndex];
-    valueCountsToUpdate.push_back(attributeValueIndex);	// add this index to our list of indices to 
-    							// update if we commit this change
-    if(valueCountPendingMove[attributeValueIndex] == 1) {
+    int newCount = valueCountPendingMove[teamIndex].increment(attributeValueIndex);
+    // add this index to our list of indices to update if we commit this change
+    valueCountsToUpdate[teamIndex].push_back(attributeValueIndex);
+    if(newCount == 1) {
 	// One more distinct value now
-	++countDistinctValuesPendingMove;
+	++countDistinctValuesPendingMove[teamIndex];
     }
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double SimilarityConstraintCost::percent_constraint_met()
+template<Constraint::Type TYPE>
+double SimilarityConstraintCostTable<TYPE>::min_delta_for_member_changes(int teamIndex, 
+	int numChanges) const
 {
-    assert(costPendingMove == cost);
-    if(!constraint->applies_to_team_size(team->size())) {
+    double pendingCost = get_pending_cost(teamIndex);
+    if(pendingCost == 0.0 || applicabilityMayChange) {
+	return -pendingCost;
+    }
+    if(TYPE == Constraint::HOMOGENEOUS) {
+	// Each change can remove at most one distinct value
+	return max(-pendingCost, -numChanges * constraint->get_weight());
+    } else {
+	// Each change can add one distinct value or reduce the maximum possible by one
+	return max(-pendingCost, -2 * numChanges * constraint->get_weight());
+    }
+}
+
+template<Constraint::Type TYPE>
+double SimilarityConstraintCostTable<TYPE>::percent_constraint_met(int teamIndex) const
+{
+    assert(costPendingMove[teamIndex] == cost[teamIndex]);
+    if(!constraint->applies_to_team_size(teams[teamIndex]->size())) {
 	return 100.0;	// constraints are assumed to be met if they do not apply to this team size
-    } else if(cost == 0.0) {
+    } else if(cost[teamIndex] == 0.0) {
 	return 100.0; 	// constraint satisfied
     } else {
 	return 0.0;
     }
-    return (costPendingMove == 0.0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// RangeConstraintCost
+// RangeConstraintCostTable
 
 // Constructor
-RangeConstraintCost::RangeConstraintCost(const TeamLevel* team, const Constraint* constraint) :
-	ConstraintCost(team, constraint),
+template<Constraint::Type TYPE>
+RangeConstraintCostTable<TYPE>::RangeConstraintCostTable(const Constraint* constraint,
+	const Partition* partition) :
+	ConstraintCostTable(constraint, partition),
 	attribute(constraint->get_attribute()),
 	attributeValueRange(0.0),
-	/*
-	minValue(INFINITY),
-	maxValue(-INFINITY),
-	*/
-	sumOfValues(0.0),
-	sumOfSquareValues(0.0),
-	numMembersConsidered(0),
-	/*
-	minValuePendingMove(INFINITY),
-	maxValuePendingMove(-INFINITY),
-	*/
-	sumOfValuesPendingMove(0.0),
-	sumOfSquareValuesPendingMove(0.0),
-	numMembersPendingMove(0)
-{
-    assert(attribute->is_numeric());
+	valueScale(1.0),
+	sumOfValues(teams.size(), 0),
+	sumOfSquareValues(teams.size(), 0),
+	numMembersConsidered(teams.size(), 0),
+	sumOfValuesPendingMove(teams.size(), 0),
+	sumOfSquareValuesPendingMove(teams.size(), 0),
+	numMembersPendingMove(teams.size(), 0)
+{
+    assert(attribute->is_numeric() && constraint->get_type() == TYPE);
     if(attribute->num_values() > 0) {
 	attributeValueRange = attribute->get_numerical_max_value() - 
 		attribute->get_numerical_min_value();
+	// Use as many fractional bits as we can while keeping scaled values within 2^20 so that 
+	// sums of squares can't overflow
+	double maxMagnitude = max(fabs(attribute->get_numerical_min_value()), 
+		fabs(attribute->get_numerical_max_value()));
+	if(maxMagnitude > 0.0) {
+	    valueScale = ldexp(1.0, 20 - ilogb(maxMagnitude) - 1);
+	}
     }
-
-    this->initialise();
-}
-
-// Destructor
-RangeConstraintCost::~RangeConstraintCost()
-{
 }
 
-void RangeConstraintCost::initialise()
+template<Constraint::Type TYPE>
+void RangeConstraintCostTable<TYPE>::initialise(int teamIndex, const ConditionBitsets* conditions)
 {
-
     // Reset measures
-    /*
-    minValuePendingMove = INFINITY;
-    maxValuePendingMove = -INFINITY;
-    */
-    sumOfValuesPendingMove = 0.0;
-    sumOfSquareValuesPendingMove = 0.0;
-    numMembersPendingMove = 0;
-
-    // Iterate over each member of the team and work out how many different values there are
-    MemberIterator memberItr(team);
-    while(!memberItr.done()) {
-	double value = memberItr->get_numeric_attribute_value(attribute);
-	sumOfValuesPendingMove += value;
-	sumOfSquareValuesPendingMove += (value * value);
-	/*
-	if(value < minValuePendingMove) {
-	    minValuePendingMove = value;
-	}
-	if(value > maxValuePendingMove) {
-	    maxValuePendingMove = value;
-	}
-	*/
+    sumOfValuesPendingMove[teamIndex] = 0;
+    sumOfSquareValuesPendingMove[teamIndex] = 0;
+    numMembersPendingMove[teamIndex] = 0;
 
-	++numMembersPendingMove;
+    // Iterate over each member of the team and sum the values and their squares
+    MemberIterator memberItr(teams[teamIndex]);
+    while(!memberItr.done()) {
+	long long value = scaled_value(memberItr);
+	sumOfValuesPendingMove[teamIndex] += value;
+	sumOfSquareValuesPendingMove[teamIndex] += (value * value);
+	++numMembersPendingMove[teamIndex];
 
 	// Move on to next member
 	++memberItr;
     }
-    this->evaluate();
-    this->commit_pending();
+    evaluate(teamIndex);
+    commit_pending(teamIndex);
 }
 
-void RangeConstraintCost::evaluate()
+template<Constraint::Type TYPE>
+long long RangeConstraintCostTable<TYPE>::scaled_value(const Member* member) const
 {
-    switch(constraint->get_type()) {
+    return llround(member->get_numeric_attribute_value(attribute) * valueScale);
+}
+
+template<Constraint::Type TYPE>
+void RangeConstraintCostTable<TYPE>::evaluate(int teamIndex)
+{
+    switch(TYPE) {
 	case Constraint::HOMOGENEOUS:
-	    if(numMembersPendingMove > 0 && attributeValueRange > 0.0) {
-		costPendingMove  = constraint->get_weight() * 2.0 * std_dev() / attributeValueRange;
+	    if(numMembersPendingMove[teamIndex] > 0 && attributeValueRange > 0.0) {
+		costPendingMove[teamIndex] = constraint->get_weight() * 2.0 * std_dev(teamIndex) / 
+			attributeValueRange;
 	    } else {
-		costPendingMove  = 0.0;
+		costPendingMove[teamIndex] = 0.0;
 	    }
 	    break;
 	case Constraint::HETEROGENEOUS:
-	    if(numMembersPendingMove > 0 && attributeValueRange > 0.0) {
-		costPendingMove  = constraint->get_weight() * 
-			(attributeValueRange - 2.0 * std_dev()) / attributeValueRange;
+	    if(numMembersPendingMove[teamIndex] > 0 && attributeValueRange > 0.0) {
+		costPendingMove[teamIndex] = constraint->get_weight() * 
+			(attributeValueRange - 2.0 * std_dev(teamIndex)) / attributeValueRange;
 	    } else {
-		costPendingMove  = 0.0;
+		costPendingMove[teamIndex] = 0.0;
 	    }
 	    break;
 	default:
@@ -496,68 +795,67 @@ void RangeConstraintCost::evaluate()
     }
 }
 
-void RangeConstraintCost::commit_pending()
+template<Constraint::Type TYPE>
+void RangeConstraintCostTable<TYPE>::commit_pending(int teamIndex)
 {
-    ConstraintCost::commit_pending();
+    ConstraintCostTable::commit_pending(teamIndex);
 
-    /*
-    minValue = minValuePendingMove;
-    maxValue = maxValuePendingMove;
-    */
-    sumOfValues = sumOfValuesPendingMove;
-    sumOfSquareValues = sumOfSquareValuesPendingMove;
-    numMembersConsidered = numMembersPendingMove;
+    sumOfValues[teamIndex] = sumOfValuesPendingMove[teamIndex];
+    sumOfSquareValues[teamIndex] = sumOfSquareValuesPendingMove[teamIndex];
+    numMembersConsidered[teamIndex] = numMembersPendingMove[teamIndex];
 }
 
-void RangeConstraintCost::undo_pending()
+template<Constraint::Type TYPE>
+void RangeConstraintCostTable<TYPE>::undo_pending(int teamIndex)
 {
-    ConstraintCost::undo_pending();
+    ConstraintCostTable::undo_pending(teamIndex);
 
-    /*
-    minValuePendingMove = minValue;
-    maxValuePendingMove = maxValue;
-    */
-    sumOfValuesPendingMove = sumOfValues;
-    sumOfSquareValuesPendingMove = sumOfSquareValues;
-    numMembersPendingMove = numMembersConsidered;
+    sumOfValuesPendingMove[teamIndex] = sumOfValues[teamIndex];
+    sumOfSquareValuesPendingMove[teamIndex] = sumOfSquareValues[teamIndex];
+    numMembersPendingMove[teamIndex] = numMembersConsidered[teamIndex];
 }
 
-double RangeConstraintCost::pend_remove_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits RangeConstraintCostTable<TYPE>::pend_remove_member(int teamIndex, const Member* member)
 {
     // We assume, but do not check that the member is part of the team
-    double costBefore = get_pending_cost();
-    --numMembersPendingMove;
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, -1);
+    --numMembersPendingMove[teamIndex];
 
-    double value = member->get_numeric_attribute_value(attribute);
-    sumOfValuesPendingMove -= value;
-    sumOfSquareValuesPendingMove -= (value * value);
+    long long value = scaled_value(member);
+    sumOfValuesPendingMove[teamIndex] -= value;
+    sumOfSquareValuesPendingMove[teamIndex] -= (value * value);
 
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double RangeConstraintCost::pend_add_member(Member* member)
+template<Constraint::Type TYPE>
+CostUnits RangeConstraintCostTable<TYPE>::pend_add_member(int teamIndex, const Member* member)
 {
     // We assume, but do not check that the member is not part of the team
-    double costBefore = get_pending_cost();
-    ++numMembersPendingMove;
+    CostUnits costBefore = get_pending_cost_units(teamIndex);
+    pend_team_size_change(teamIndex, 1);
+    ++numMembersPendingMove[teamIndex];
 
-    double value = member->get_numeric_attribute_value(attribute);
-    sumOfValuesPendingMove += value;
-    sumOfSquareValuesPendingMove += (value * value);
+    long long value = scaled_value(member);
+    sumOfValuesPendingMove[teamIndex] += value;
+    sumOfSquareValuesPendingMove[teamIndex] += (value * value);
 
-    evaluate();
-    return (get_pending_cost() - costBefore);
+    evaluate(teamIndex);
+    return (get_pending_cost_units(teamIndex) - costBefore);
 }
 
-double RangeConstraintCost::percent_constraint_met()
+template<Constraint::Type TYPE>
+double RangeConstraintCostTable<TYPE>::percent_constraint_met(int teamIndex) const
 {
-    if(!constraint->applies_to_team_size(team->size())) {
+    if(!constraint->applies_to_team_size(teams[teamIndex]->size())) {
 	return 100.0;	// constraints are assumed to be met if they do not apply to this team size
-    } else if(constraint->get_type() == Constraint::HOMOGENEOUS) {
+    } else if(TYPE == Constraint::HOMOGENEOUS) {
 	if(attributeValueRange == 0.0) {
 	    return 100.0; // constraint met
-	} else if ((std_dev() / attributeValueRange) < 0.1) {
+	} else if ((std_dev(teamIndex) / attributeValueRange) < 0.1) {
 	    return 100.0;	// we'll consider the constraint met
 	} else {
 	    return 0.0;
@@ -565,7 +863,7 @@ double RangeConstraintCost::percent_constraint_met()
     } else { // Constraint::HETEROGENEOUS:
 	if(attributeValueRange == 0.0) {
 	    return 0.0;
-	} else if ((std_dev() / attributeValueRange) > 0.25) {
+	} else if ((std_dev(teamIndex) / attributeValueRange) > 0.25) {
 	    // consider constraint met
 	    return 100.0;
 	} else {
@@ -574,22 +872,16 @@ double RangeConstraintCost::percent_constraint_met()
     }
 }
 
-double RangeConstraintCost::std_dev()
+template<Constraint::Type TYPE>
+double RangeConstraintCostTable<TYPE>::std_dev(int teamIndex) const
 {
-    assert(numMembersPendingMove > 0);
-    double num = numMembersPendingMove;
-    double delta = num * sumOfSquareValuesPendingMove - sumOfValuesPendingMove * sumOfValuesPendingMove;
+    assert(numMembersPendingMove[teamIndex] > 0);
+    double num = numMembersPendingMove[teamIndex];
+    double sum = sumOfValuesPendingMove[teamIndex];
+    double delta = num * sumOfSquareValuesPendingMove[teamIndex] - sum * sum;
     if(delta > 0.0) {
-	return sqrt(delta) / num;
+	return sqrt(delta) / num / valueScale;
     } else {
 	return 0;
     }
 }
-
-#if 0
-double RangeConstraintCost::range()
-{
-    assert(numMembersPendingMove > 0);
-    return (maxValuePendingMove - minValuePendingMove);
-}
-#endif
@@ -9,178 +9,243 @@
 #include "constraint.hh"
 #include "person.hh"
 #include "entity.hh"
+#include "conditionBitsets.hh"
+#include "valueCounts.hh"
 #include <map>
 #include <vector>
 
-///////////////////////////////////////////////////////////////////////////////
-// ConstraintCost
-
-// Cost of constraint for a given team - there is one of these objects for every team at the level the 
-// constraint applies to. (The constraint may not apply if the team size is wrong but there will still
-// be one of these objects.) This is an abstract base class - descendant classes will be specific to the
-// types of constraints since constraint specific data needs to be stored.
+// Costs are totalled in fixed point so that totals maintained by adding the deltas of many moves
+// are always exactly the sum of the individual costs (i.e. they can't drift)
+typedef long long CostUnits;
 
-class ConstraintCost {
+///////////////////////////////////////////////////////////////////////////////
+// ConstraintCostTable
+
+// Costs of a constraint for all the teams at the level the constraint applies to (one table per
+// constraint per partition). The state of each team - costs, counts, sums etc. - is kept in arrays
+// indexed by the team's index at that level, so the state of a constraint is contiguous. This is
+// an abstract base class - descendant class templates hold the state needed by each type of
+// constraint. The constraint type is a template parameter so that the cost calculation for the
+// type is chosen once, when the table is constructed, rather than on every evaluation.
+class ConstraintCostTable {
+    friend class CostData;
 protected:
-    const TeamLevel* team;
     const Constraint* constraint;
-    double cost;			// of current state and committed moves
-    double costPendingMove;
-    int teamSizePendingMove;
-    // Constructor
-    ConstraintCost(const TeamLevel* team, const Constraint* constraint);
+    const bool applicabilityMayChange;	// true if member changes may change whether the 
+    					// constraint applies to a team
+    vector<const TeamLevel*> teams;	// Teams at the constraint's level, indexed by team index
+    vector<double> cost;		// of current state and committed moves
+    vector<double> costPendingMove;
+    vector<int> teamSizePendingMove;
+    vector<unsigned long long> pendingEpoch;	// CostData's epoch when each cost was last pended
+
+    // Constructor - the costs are not calculated until initialise_all() is called
+    ConstraintCostTable(const Constraint* constraint, const Partition* partition);
+
+    // Calculate the cost data of the given team from its current members. Counts of members 
+    // meeting conditions may be taken from the given snapshot (if given).
+    virtual void initialise(int teamIndex, const ConditionBitsets* conditions) = 0;
+    void initialise_all(const ConditionBitsets* conditions);
+    // Update the pending team size when a member is removed (change = -1) or added (change = 1).
+    // Only lowest level team sizes depend on the members - sizes of higher level teams are the
+    // number of sub-teams.
+    void pend_team_size_change(int teamIndex, int change);
 
 public:
     // Destructor (virtual)
-    virtual ~ConstraintCost();
-
-public:
-    // Check that the constraint applies (team size wise) and if so, return the cost, otherwise
-    // return 0;
-    double get_cost();
-    double get_pending_cost();
-    double delta_cost();		// pending minus committed, negative if better
+    virtual ~ConstraintCostTable();
 
-    const TeamLevel* get_team() const;
     const Constraint* get_constraint() const;
+    int num_teams() const;
+    const TeamLevel* get_team(int teamIndex) const;
 
-    virtual void evaluate() = 0;	// evaluate cost of current situation (pending move)
-    virtual void commit_pending();	// commit the cost changes associated with pending moves
-    					// (we assume this happens after teams are updated so that
-					// we can update the teamSizePendingMove)
-    virtual void undo_pending();	// Undo any pending changes (team membership unchanged)
+    // Check that the constraint applies (team size wise) and if so, return the cost, otherwise
+    // return 0;
+    double get_cost(int teamIndex) const;
+    double get_pending_cost(int teamIndex) const;
+    CostUnits get_cost_units(int teamIndex) const;
+    CostUnits get_pending_cost_units(int teamIndex) const;
 
     // Functions to determine the effect of changes to team membership - returns the delta cost
-    // of just this move (ignoring other pending moves). Negative is better.
-    virtual double pend_remove_member(Member* member) = 0;
-    virtual double pend_add_member(Member* member) = 0;
+    // (in cost units) of just this move (ignoring other pending moves). Negative is better.
+    virtual CostUnits pend_remove_member(int teamIndex, const Member* member) = 0;
+    virtual CostUnits pend_add_member(int teamIndex, const Member* member) = 0;
+    // Commit the cost changes associated with pending moves (we assume this happens after teams
+    // are updated so that we can check the pending team size)
+    virtual void commit_pending(int teamIndex);
+    virtual void undo_pending(int teamIndex);	// Undo any pending changes
+    // Recalculate the team's cost from its current membership (discards any pending changes).
+    // The conditions (if given) must be a snapshot of the current teams.
+    void recalculate(int teamIndex, const ConditionBitsets* conditions = nullptr);
+
+    // Lower bound on the change in the team's pending cost if up to the given number of members
+    // are added to and/or removed from it. Costs can't go below zero so the default is minus the
+    // pending cost.
+    virtual double min_delta_for_member_changes(int teamIndex, int numChanges) const;
 
     // For statistics purposes - percentage (0 to 100) of constraint satisfaction
     // (value will usually be 0 or 100 - except for minimise/maximise constraints)
     // (If the constraint does not apply to teams of this size then we return 100%)
-    virtual double percent_constraint_met() = 0;
+    virtual double percent_constraint_met(int teamIndex) const = 0;
 
-    // Factory
-    static ConstraintCost* construct(const TeamLevel* team, const Constraint* constraint);
+    // Factory - creates the table for the given constraint's type and calculates the costs of
+    // the partition's teams. The conditions (if given) must be a snapshot of the current teams.
+    static ConstraintCostTable* construct(const Constraint* constraint, const Partition* partition,
+	    const ConditionBitsets* conditions = nullptr);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
-// CountConstraintCost
+// ConstraintCost
+
+// Cost of constraint for a given team - there is one of these objects for every team at the level the 
+// constraint applies to. (The constraint may not apply if the team size is wrong but there will still
+// be one of these objects.) The cost data itself is the team's entry in the constraint's cost table.
 
-// Costs of constraints which relate to counts of the number of members with certain properties
-class CountConstraintCost : public ConstraintCost {
+class ConstraintCost {
+private:
+    ConstraintCostTable* table;
+    int teamIndex;
+public:
+    // Constructor
+    ConstraintCost(ConstraintCostTable* table, int teamIndex);
+
+    // Check that the constraint applies (team size wise) and if so, return the cost, otherwise
+    // return 0;
+    double get_cost() const;
+    double get_pending_cost() const;
+    double delta_cost() const;		// pending minus committed, negative if better
+    CostUnits get_cost_units() const;
+    CostUnits get_pending_cost_units() const;
+
+    // Conversion between costs and the fixed point units they are totalled in
+    static CostUnits to_cost_units(double cost);
+    static double from_cost_units(CostUnits units);
+
+    ConstraintCostTable* get_table() const;
+    int get_team_index() const;
+    const TeamLevel* get_team() const;
+    const Constraint* get_constraint() const;
+
+    // Lower bound on the change in pending cost if up to the given number of members are added
+    // to and/or removed from the team.
+    double min_delta_for_member_changes(int numChanges) const;
+
+    // For statistics purposes - percentage (0 to 100) of constraint satisfaction
+    double percent_constraint_met() const;
+
+    // Lower bound on the total cost (in cost units) of the constraint over all the teams at its
+    // level, however the members are arranged. Only partition wide counts are used - the number
+    // of teams at the level and, over all of those teams, the number of members, the number
+    // meeting the constraint's condition (count constraints) and the number of distinct values
+    // of the attribute (similarity constraints). 0 if no useful bound is known.
+    static CostUnits lower_bound(const Constraint* constraint, int numTeams, int numMembers,
+	    int numMeetingCondition, int numDistinctValues);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CountConstraintCostTable
+
+// Costs of constraints which relate to counts of the number of members with certain properties.
+// (Each type's class is final so the calls to evaluate() from the pend functions aren't virtual.)
+template<Constraint::Type TYPE>
+class CountConstraintCostTable final : public ConstraintCostTable {
 private:
     const int target;
     const int constraintNumber;
 
-    int numMembersConsidered;
-    int count;
+    vector<int> numMembersConsidered;
+    vector<int> count;
+
+    vector<int> numMembersPendingMove;
+    vector<int> countPendingMove;
 
-    int numMembersPendingMove;
-    int countPendingMove;
+    void initialise(int teamIndex, const ConditionBitsets* conditions);
+    void evaluate(int teamIndex);	// update pending cost based on current count, num members etc.
 public:
     // Constructor
-    CountConstraintCost(const TeamLevel* team, const Constraint* constraint);
+    CountConstraintCostTable(const Constraint* constraint, const Partition* partition);
 
-    // Destructor
-    ~CountConstraintCost();
+    CostUnits pend_remove_member(int teamIndex, const Member* member);
+    CostUnits pend_add_member(int teamIndex, const Member* member);
+    void commit_pending(int teamIndex);
+    void undo_pending(int teamIndex);
+    double min_delta_for_member_changes(int teamIndex, int numChanges) const;
 
-private:
-    void initialise();		// initalise
-public:
-    void evaluate();		// update pending cost based on current count, num members, target, constraint etc.
-    void commit_pending();	// commit the pending move(s) - update count, numMembersConsidered, cost
-    void undo_pending();
-    double pend_remove_member(Member* member);
-    double pend_add_member(Member* member);
-
-    double percent_constraint_met();
+    double percent_constraint_met(int teamIndex) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
-// SimilarityConstraintCost
+// SimilarityConstraintCostTable
 
-// Costs of constraints which relate to string fields with same value 
-class SimilarityConstraintCost : public ConstraintCost {
+// Costs of constraints which relate to string fields with same value (TYPE is HOMOGENEOUS or
+// HETEROGENEOUS)
+template<Constraint::Type TYPE>
+class SimilarityConstraintCostTable final : public ConstraintCostTable {
 private:
     const Attribute* const attribute;
     const int numAttributeValues;	// Number of different possible values for this attribute
 
-    vector<int> valueCount;	// Indexed by attribute string value index - number of members with their
-    				// attribute value being this value
-    int countDistinctValues;		// Number of different values for the attribute in this (original) team
-    int numMembersConsidered;		// Number of members in team
+    // Number of members of each team with each value of the attribute
+    vector<ValueCounts> valueCount;
+    vector<int> countDistinctValues;	// Number of different values for the attribute in each team
+    vector<int> numMembersConsidered;	// Number of members in each team
 
-    vector<int> valueCountPendingMove;
-    vector<int> valueCountsToUpdate;		// records index of value counts that are different 
-    						// between the committed and pending arrays
-    int countDistinctValuesPendingMove;	// Number of different values for the attribute in the pending team
-    int numMembersPendingMove;		// Number of members in the pending team
+    vector<ValueCounts> valueCountPendingMove;
+    vector<vector<int> > valueCountsToUpdate;	// for each team, values whose counts are different
+    						// between the committed and pending counts
+    vector<int> countDistinctValuesPendingMove;
+    vector<int> numMembersPendingMove;
 
+    void initialise(int teamIndex, const ConditionBitsets* conditions);
+    void evaluate(int teamIndex);	// update pending cost based on current data
 public:
     // Constructor
-    SimilarityConstraintCost(const TeamLevel* team, const Constraint* constraint);
+    SimilarityConstraintCostTable(const Constraint* constraint, const Partition* partition);
 
-    // Destructor
-    ~SimilarityConstraintCost();
-
-private:
-    void initialise();		// intialise
-public:
-    void evaluate();		// update pending cost based on current data
-    void commit_pending();	// commit the pending move(s) - update member variables
-    void undo_pending();
-    double pend_remove_member(Member* member);
-    double pend_add_member(Member* member);
+    CostUnits pend_remove_member(int teamIndex, const Member* member);
+    CostUnits pend_add_member(int teamIndex, const Member* member);
+    void commit_pending(int teamIndex);
+    void undo_pending(int teamIndex);
+    double min_delta_for_member_changes(int teamIndex, int numChanges) const;
 
-    double percent_constraint_met();
+    double percent_constraint_met(int teamIndex) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
-// RangeConstraintCost
+// RangeConstraintCostTable
 
-// Costs of constraints which relate to string fields with same value 
-class RangeConstraintCost : public ConstraintCost {
+// Costs of constraints which relate to the spread of numeric field values (TYPE is HOMOGENEOUS
+// or HETEROGENEOUS)
+template<Constraint::Type TYPE>
+class RangeConstraintCostTable final : public ConstraintCostTable {
 private:
     const Attribute* const attribute;
     double attributeValueRange;
+    double valueScale;		// Values are summed in fixed point - this is the number of units
+    				// per unit of the attribute value (a power of two)
     
-    /*
-    double minValue;
-    double maxValue;
-    */
-    double sumOfValues;
-    double sumOfSquareValues;
-    int numMembersConsidered;
-
-    /*
-    double minValuePendingMove;
-    double maxValuePendingMove;
-    */
-    double sumOfValuesPendingMove;
-    double sumOfSquareValuesPendingMove;
-    int numMembersPendingMove;
+    vector<long long> sumOfValues;
+    vector<long long> sumOfSquareValues;
+    vector<int> numMembersConsidered;
+
+    vector<long long> sumOfValuesPendingMove;
+    vector<long long> sumOfSquareValuesPendingMove;
+    vector<int> numMembersPendingMove;
+
+    void initialise(int teamIndex, const ConditionBitsets* conditions);
+    long long scaled_value(const Member* member) const;	// fixed point attribute value
+    void evaluate(int teamIndex);	// update pending cost based on current data
+    double std_dev(int teamIndex) const;	// standard deviation of values in the pending team
 public:
     // Constructor
-    RangeConstraintCost(const TeamLevel* team, const Constraint* constraint);
+    RangeConstraintCostTable(const Constraint* constraint, const Partition* partition);
 
-    // Destructor
-    ~RangeConstraintCost();
+    CostUnits pend_remove_member(int teamIndex, const Member* member);
+    CostUnits pend_add_member(int teamIndex, const Member* member);
+    void commit_pending(int teamIndex);
+    void undo_pending(int teamIndex);
 
-private:
-    void initialise();
-public:
-    void evaluate();		// update pending cost based on current data
-    void commit_pending();
-    void undo_pending();
-    double pend_remove_member(Member* member);
-    double pend_add_member(Member* member);
-
-    double percent_constraint_met();
-
-    double std_dev();	// return standard deviation of values in this team - pending moves
-    //double range();	// return range of values in this team - pending moves
+    double percent_constraint_met(int teamIndex) const;
 };
 
 #endif
-
@@ -0,0 +1,239 @@
+//
+// coolingSchedule.cpp
+//
+
+#include "coolingSchedule.hh"
+#include <cmath>
+#include <algorithm>
+#include "assert.h"
+
+// Factor the temperature is multiplied by after each step of a geometric schedule
+static const double GEOMETRIC_COOLING_RATE = 0.98;
+// Number of steps the Lundy-Mees schedule takes to cool to the final temperature
+static const int LUNDY_MEES_STEPS = 300;
+// Size of the move budget for the Lam schedule and the length of each of its steps (per
+// member of the partition)
+static const int LAM_MOVES_PER_MEMBER = 3000;
+static const int LAM_STEP_MOVES_PER_MEMBER = 4;
+// The Lam schedule's temperature correction is damped (the proportion of uphill moves accepted
+// in a step is noisy) and limited to this factor per step
+static const double LAM_CORRECTION_DAMPING = 0.5;
+static const double LAM_MAX_CORRECTION = 2.0;
+
+const char* CoolingSchedule::typeNames[NUM_TYPES] = {
+    "default", "geometric", "lundy-mees", "lam"
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CoolingSchedule
+
+// Constructor
+CoolingSchedule::CoolingSchedule(double initialTemperature, double finalTemperature, 
+		int numMembers) :
+	initialTemperature(initialTemperature),
+	finalTemperature(finalTemperature),
+	numMembers(numMembers),
+	numMovesMade(0),
+	numStepsCompleted(0),
+	budgetFractionUsed(-1.0)
+{
+}
+
+// Destructor
+CoolingSchedule::~CoolingSchedule()
+{
+}
+
+int CoolingSchedule::step_length(double uphillProbability) const
+{
+    if(uphillProbability > 0.7 || uphillProbability < 0.2) {
+	return numMembers * 4;
+    } else if(uphillProbability > 0.6 || uphillProbability < 0.3) {
+	return numMembers * 8;
+    } else {
+	return numMembers * 32;
+    }
+}
+
+double CoolingSchedule::step_completed(double temperature, int numMoves, double uphillProbability,
+	double budgetFractionUsed)
+{
+    numMovesMade += numMoves;
+    ++numStepsCompleted;
+    this->budgetFractionUsed = budgetFractionUsed;
+    return next_temperature(temperature, uphillProbability);
+}
+
+bool CoolingSchedule::finished() const
+{
+    return false;
+}
+
+bool CoolingSchedule::find_type(const string& name, Type& type)
+{
+    for(int i = 0; i < NUM_TYPES; ++i) {
+	if(name == typeNames[i]) {
+	    type = (Type)i;
+	    return true;
+	}
+    }
+    return false;
+}
+
+CoolingSchedule* CoolingSchedule::construct(Type type, double initialTemperature, 
+	double finalTemperature, int numMembers)
+{
+    switch(type) {
+	case DEFAULT:
+	case GEOMETRIC:
+	    return new GeometricCoolingSchedule(initialTemperature, finalTemperature, numMembers);
+	case LUNDY_MEES:
+	    return new LundyMeesCoolingSchedule(initialTemperature, finalTemperature, numMembers);
+	case LAM:
+	    return new LamCoolingSchedule(initialTemperature, finalTemperature, numMembers);
+    }
+    assert(0);
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GeometricCoolingSchedule
+
+// Constructor
+GeometricCoolingSchedule::GeometricCoolingSchedule(double initialTemperature, 
+		double finalTemperature, int numMembers) :
+	CoolingSchedule(initialTemperature, finalTemperature, numMembers)
+{
+}
+
+double GeometricCoolingSchedule::next_temperature(double temperature, double uphillProbability)
+{
+    if(budgetFractionUsed >= 0.0 && finalTemperature > 0.0 && 
+	    finalTemperature < initialTemperature) {
+	return initialTemperature * pow(finalTemperature / initialTemperature, budgetFractionUsed);
+    }
+    return temperature * GEOMETRIC_COOLING_RATE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LundyMeesCoolingSchedule
+
+// Constructor
+LundyMeesCoolingSchedule::LundyMeesCoolingSchedule(double initialTemperature, 
+		double finalTemperature, int numMembers) :
+	CoolingSchedule(initialTemperature, finalTemperature, numMembers)
+{
+}
+
+double LundyMeesCoolingSchedule::progress() const
+{
+    if(budgetFractionUsed >= 0.0) {
+	return budgetFractionUsed;
+    }
+    return min(1.0, (double)numStepsCompleted / LUNDY_MEES_STEPS);
+}
+
+bool LundyMeesCoolingSchedule::finished() const
+{
+    return progress() >= 1.0;
+}
+
+double LundyMeesCoolingSchedule::next_temperature(double temperature, double uphillProbability)
+{
+    if(finalTemperature <= 0.0 || finalTemperature >= initialTemperature) {
+	return temperature;
+    }
+    // Applying T / (1 + beta * T) k times gives T0 / (1 + k * beta * T0) - beta is chosen so
+    // that this is the final temperature after all the steps
+    return initialTemperature / 
+	    (1.0 + (initialTemperature / finalTemperature - 1.0) * progress());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LamCoolingSchedule
+
+// Constructor
+LamCoolingSchedule::LamCoolingSchedule(double initialTemperature, double finalTemperature, 
+		int numMembers) :
+	CoolingSchedule(initialTemperature, finalTemperature, numMembers),
+	moveBudget((long long)LAM_MOVES_PER_MEMBER * numMembers)
+{
+}
+
+int LamCoolingSchedule::step_length(double uphillProbability) const
+{
+    // Short steps so that the temperature tracks the target closely
+    return numMembers * LAM_STEP_MOVES_PER_MEMBER;
+}
+
+double LamCoolingSchedule::fraction_of_budget_used() const
+{
+    if(budgetFractionUsed >= 0.0) {
+	return budgetFractionUsed;
+    }
+    return min(1.0, (double)numMovesMade / moveBudget);
+}
+
+bool LamCoolingSchedule::finished() const
+{
+    return fraction_of_budget_used() >= 1.0;
+}
+
+double LamCoolingSchedule::target_uphill_probability(double fractionOfBudget)
+{
+    if(fractionOfBudget < 0.15) {
+	return 0.44 + 0.56 * pow(560.0, -fractionOfBudget / 0.15);
+    } else if(fractionOfBudget < 0.65) {
+	return 0.44;
+    } else {
+	return 0.44 * pow(440.0, -(fractionOfBudget - 0.65) / 0.35);
+    }
+}
+
+double LamCoolingSchedule::next_temperature(double temperature, double uphillProbability)
+{
+    // If uphill moves of a typical size d are accepted with probability p = exp(-d/T) then
+    // the target probability q is reached at T * log(p) / log(q)
+    double target = target_uphill_probability(fraction_of_budget_used());
+    target = min(max(target, 0.001), 0.999);
+    uphillProbability = min(max(uphillProbability, 0.001), 0.999);
+    double correction = pow(log(uphillProbability) / log(target), LAM_CORRECTION_DAMPING);
+    correction = min(max(correction, 1.0 / LAM_MAX_CORRECTION), LAM_MAX_CORRECTION);
+    return temperature * correction;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CoolingOptions
+
+// Constructor
+CoolingOptions::CoolingOptions() :
+	schedule(CoolingSchedule::DEFAULT),
+	scheduleGiven(false),
+	maxReheats(-1)
+{
+}
+
+bool CoolingOptions::set_schedule(const string& name)
+{
+    if(!CoolingSchedule::find_type(name, schedule)) {
+	return false;
+    }
+    scheduleGiven = true;
+    return true;
+}
+
+void CoolingOptions::add_defaults_from(const CoolingOptions& other)
+{
+    if(!scheduleGiven) {
+	schedule = other.schedule;
+	scheduleGiven = other.scheduleGiven;
+    }
+    if(maxReheats < 0) {
+	maxReheats = other.maxReheats;
+    }
+}
+
+int CoolingOptions::num_reheats_allowed() const
+{
+    return max(maxReheats, 0);
+}
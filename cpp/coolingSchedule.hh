@@ -0,0 +1,149 @@
+//
+// coolingSchedule.hh
+//
+
+#ifndef COOLINGSCHEDULE_HH
+#define COOLINGSCHEDULE_HH
+
+#include <string>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CoolingSchedule
+//
+// Decides how the temperature of an anneal changes and how many moves are made at each
+// temperature. The anneal is made up of steps - after each step the schedule is told the
+// proportion of uphill moves that were accepted and chooses the temperature for the next step.
+// This is an abstract base class - descendant classes implement each type of schedule.
+
+class CoolingSchedule {
+public:
+    typedef enum {DEFAULT, GEOMETRIC, LUNDY_MEES, LAM} Type;
+    static const int NUM_TYPES = 4;
+    static const char* typeNames[NUM_TYPES];	// as used in the constraint file and command line
+protected:
+    const double initialTemperature;
+    const double finalTemperature;	// estimate of the temperature at which the anneal freezes
+    const int numMembers;
+    long long numMovesMade;		// moves made in the steps completed so far
+    int numStepsCompleted;
+    double budgetFractionUsed;		// fraction of the anneal's budget (time or moves) used 
+    					// (negative if the anneal isn't limited)
+
+    // Constructor
+    CoolingSchedule(double initialTemperature, double finalTemperature, int numMembers);
+public:
+    // Destructor (virtual)
+    virtual ~CoolingSchedule();
+
+    // Number of moves to make in the next step (given the proportion of uphill moves accepted
+    // in the last step). By default longer steps are used when about half the uphill moves are
+    // being accepted (the temperatures at which most of the progress is made).
+    virtual int step_length(double uphillProbability) const;
+    // Record the completion of a step (of the given number of moves) and return the
+    // temperature for the next step. If the anneal has a budget, the schedule is stretched or
+    // compressed to reach the final temperature when the budget is used up.
+    double step_completed(double temperature, int numMoves, double uphillProbability,
+	    double budgetFractionUsed);
+    // True if the schedule has run its course. (Otherwise the anneal continues until hardly
+    // any uphill moves are accepted or the budget is used up.)
+    virtual bool finished() const;
+
+    // Look up a schedule type by name - returns false if the name isn't known
+    static bool find_type(const string& name, Type& type);
+    // Factory - DEFAULT gives a geometric schedule
+    static CoolingSchedule* construct(Type type, double initialTemperature, 
+	    double finalTemperature, int numMembers);
+
+protected:
+    virtual double next_temperature(double temperature, double uphillProbability) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// GeometricCoolingSchedule
+
+// The temperature is reduced by a constant factor after every step. (With a budget, the
+// temperature falls exponentially from the initial to the final temperature over the budget.)
+class GeometricCoolingSchedule final : public CoolingSchedule {
+public:
+    // Constructor
+    GeometricCoolingSchedule(double initialTemperature, double finalTemperature, int numMembers);
+
+protected:
+    double next_temperature(double temperature, double uphillProbability);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// LundyMeesCoolingSchedule
+
+// Lundy and Mees' schedule - T(k+1) = T(k) / (1 + beta * T(k)). The temperature falls
+// quickly while it is high and ever more slowly as it approaches zero, so less time is spent
+// at high temperatures, where moves are almost random, and more at low temperatures. Beta is
+// chosen so that the final temperature is reached after a fixed number of steps (or when the
+// budget is used up).
+class LundyMeesCoolingSchedule final : public CoolingSchedule {
+private:
+    double progress() const;	// fraction (0 to 1) of the way to the final temperature
+public:
+    // Constructor
+    LundyMeesCoolingSchedule(double initialTemperature, double finalTemperature, int numMembers);
+
+    bool finished() const;
+protected:
+    double next_temperature(double temperature, double uphillProbability);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// LamCoolingSchedule
+
+// Adaptive control of the temperature after Lam and Huang (in the modified form described by
+// Boyan). The anneal has a fixed budget of moves (or the anneal's own budget, if it has one)
+// and the temperature is adjusted after each
+// step so that the proportion of uphill moves accepted follows a target trajectory: from
+// all uphill moves down to 44% over the first 15% of the budget, steady at 44% to 65% of
+// the budget, then down towards none by the end of the budget.
+class LamCoolingSchedule final : public CoolingSchedule {
+private:
+    const long long moveBudget;
+    double fraction_of_budget_used() const;
+public:
+    // Constructor
+    LamCoolingSchedule(double initialTemperature, double finalTemperature, int numMembers);
+
+    int step_length(double uphillProbability) const;
+    bool finished() const;
+
+    // Target proportion of uphill moves accepted once the given fraction (0 to 1) of the
+    // move budget has been used
+    static double target_uphill_probability(double fractionOfBudget);
+protected:
+    double next_temperature(double temperature, double uphillProbability);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CoolingOptions
+
+// Settings (from the constraint file and/or command line) which control the cooling
+class CoolingOptions {
+public:
+    CoolingSchedule::Type schedule;	// DEFAULT if not given
+    bool scheduleGiven;			// true if given (even if "default" was given)
+    // Maximum number of times the anneal is reheated when it stagnates (the lowest cost hasn't
+    // improved for a while or hardly any uphill moves are being accepted) - negative if not
+    // given (0 is used)
+    int maxReheats;
+
+    // Constructor - nothing given
+    CoolingOptions();
+
+    // Set the schedule from its name - returns false if the name isn't known
+    bool set_schedule(const string& name);
+
+    // Take any settings not given here from the other options (e.g. command line settings
+    // override those from the constraint file)
+    void add_defaults_from(const CoolingOptions& other);
+    int num_reheats_allowed() const;
+};
+
+#endif
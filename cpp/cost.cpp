@@ -7,6 +7,8 @@
 #include "constraintCostList.hh"
 #include "teamData.hh"
 #include "assert.h"
+#include <algorithm>
+#include <cstring>
 
 AllCostData* allCostData = nullptr;
 
@@ -141,16 +143,24 @@ void CostData::add_constraint_cost(ConstraintCost* constraintCost)
     teamCostMap->insert(pair<const TeamLevel*,ConstraintCost*>(team, constraintCost));
 
     // Update cost totals
-    cost += constraintCost->get_cost();
-    costPendingMove += constraintCost->get_pending_cost();	// should be the same as above
+    cost += constraintCost->get_cost_units();
+    costPendingMove += constraintCost->get_pending_cost_units();	// should be the same as above
 }
 
 // Constructor
 CostData::CostData(AnnealInfo& annealInfo, Partition* partition) :
 	annealInfo(annealInfo),
 	partition(partition),
-	cost(0.0),
-	costPendingMove(0.0)
+	cost(0),
+	costPendingMove(0),
+	costLowerBound(0),
+	pendingEpoch(1),
+	numCostEvaluations(0),
+	commitCount(0),
+	swapDeltaLookups(0),
+	swapDeltaHits(0),
+	swapDeltaBypassRemaining(0),
+	teamCostWeightsEnabled(false)
 {
     // Iterate over each member in the partition and determine whether the conditions are 
     // met for each constraint (set the "conditionMet" property)
@@ -164,36 +174,250 @@ CostData::CostData(AnnealInfo& annealInfo, Partition* partition) :
 	}
 	++memberItr;
     }
+    assign_member_signatures();
     initialise_constraint_costs();
+    compute_cost_lower_bound();
 }
 
-void CostData::initialise_constraint_costs()
+void CostData::compute_cost_lower_bound()
+{
+    costLowerBound = 0;
+    int numConstraints = annealInfo.num_constraints();
+    for(int c = 0; c < numConstraints; ++c) {
+	Constraint* constraint = annealInfo.get_constraint(c);
+	const Attribute* attribute = constraint->get_attribute();
+	bool countValues = (constraint->get_type() == Constraint::HOMOGENEOUS &&
+		constraint->applies_to_string_field());
+	vector<bool> valueSeen(countValues ? attribute->num_values() : 0, false);
+	// Count over the members of the teams at the constraint's level
+	int numTeams = 0;
+	int numMembers = 0;
+	int numMeetingCondition = 0;
+	int numDistinctValues = 0;
+	EntityListIterator teamItr(partition->teams_at_level_iterator(constraint->get_level()));
+	while(!teamItr.done()) {
+	    ++numTeams;
+	    MemberIterator memberItr(teamItr);
+	    while(!memberItr.done()) {
+		++numMembers;
+		if(memberItr->is_condition_met(c)) {
+		    ++numMeetingCondition;
+		}
+		if(countValues) {
+		    int value = memberItr->get_attribute_value_index(attribute);
+		    if(!valueSeen[value]) {
+			valueSeen[value] = true;
+			++numDistinctValues;
+		    }
+		}
+		++memberItr;
+	    }
+	    ++teamItr;
+	}
+	costLowerBound += ConstraintCost::lower_bound(constraint, numTeams, numMembers, 
+		numMeetingCondition, numDistinctValues);
+    }
+}
+
+void CostData::assign_member_signatures()
+{
+    // The signature is based on everything the constraints look at - the condition for count
+    // constraints and the attribute value for others. Members with the same values get the
+    // same signature.
+    map<vector<unsigned long long>,int> signatures;
+    vector<unsigned long long> values;
+    memberSignatures.assign(partition->num_members(), -1);
+    int numConstraints = annealInfo.num_constraints();
+    MemberIterator memberItr = partition->member_iterator();
+    while(!memberItr.done()) {
+	values.clear();
+	for(int c = 0; c < numConstraints; ++c) {
+	    Constraint* constraint = annealInfo.get_constraint(c);
+	    if(constraint->is_count_constraint()) {
+		values.push_back(memberItr->is_condition_met(c));
+	    } else if(constraint->applies_to_string_field()) {
+		values.push_back(memberItr->get_attribute_value_index(constraint->get_attribute()));
+	    } else {
+		// Compare the bits of numeric values (so that identical values always match)
+		double value = memberItr->get_numeric_attribute_value(constraint->get_attribute());
+		unsigned long long bits;
+		memcpy(&bits, &value, sizeof(bits));
+		values.push_back(bits);
+	    }
+	}
+	int newSignature = signatures.size();
+	memberSignatures[memberItr->get_index()] = 
+		signatures.insert(make_pair(values, newSignature)).first->second;
+	++memberItr;
+    }
+}
+
+// Destructor
+CostData::~CostData()
 {
-    // Iterate over all the constraint cost lists and delete all the members
+    delete_constraint_costs();
+}
+
+// Delete all the constraint costs and the lists/maps that refer to them
+void CostData::delete_constraint_costs()
+{
+    // Iterate over all the constraint cost lists and delete all the members. (Each constraint 
+    // cost appears in exactly one team list.)
     CostData::TeamIterator teamListItr = this->team_begin();
     while(teamListItr != this->team_end()) {
 	teamListItr->second->delete_members();
 	delete teamListItr->second;
 	++teamListItr;
     }
+    map<const Constraint*,ConstraintCostList*>::iterator constraintListItr = 
+	    constraintToCostListMap.begin();
+    while(constraintListItr != constraintToCostListMap.end()) {
+	delete constraintListItr->second;
+	++constraintListItr;
+    }
+    map<const Constraint*,TeamToCostMap*>::iterator teamCostMapItr = constraintToTeamCostMap.begin();
+    while(teamCostMapItr != constraintToTeamCostMap.end()) {
+	delete teamCostMapItr->second;
+	++teamCostMapItr;
+    }
     teamToCostListMap.clear();
     constraintToCostListMap.clear();
-    costsToBeUpdatedOnMove.clear();
+    for(unsigned int c = 0; c < constraintCostTables.size(); ++c) {
+	delete constraintCostTables[c];
+    }
+    constraintCostTables.clear();
+    clear_pending();
     constraintToTeamCostMap.clear();
+    costChainEntries.clear();
+    for(int levelNum = 0; levelNum <= MAX_LEVELS; ++levelNum) {
+	costChains[levelNum].clear();
+    }
+}
+
+void CostData::initialise_constraint_costs()
+{
+    delete_constraint_costs();
     cost = 0;
     costPendingMove = 0;
 
-    // For each constraint, iterate over the teams at that level and built up the cost data
+    // For each constraint, build the table of costs of the teams at that level and then add
+    // the cost of each team. (Count constraint costs take their counts from a snapshot of the
+    // members' conditions.)
+    ConditionBitsets conditions(annealInfo, partition);
     int numConstraints = annealInfo.num_constraints();
     for(int c = 0; c < numConstraints; ++c) {
 	Constraint* constraint = annealInfo.get_constraint(c);
+	ConstraintCostTable* table = ConstraintCostTable::construct(constraint, partition, 
+		&conditions);
+	constraintCostTables.push_back(table);
 	EntityListIterator teamItr(partition->teams_at_level_iterator(constraint->get_level()));
 	// Iterate over the teams at this level
 	while(!teamItr.done()) {
-	    this->add_constraint_cost(ConstraintCost::construct((TeamLevel*)teamItr, constraint));
+	    this->add_constraint_cost(new ConstraintCost(table, teamItr->get_index()));
+	    ++teamItr;
+	}
+    }
+    build_cost_chains();
+    clear_swap_deltas();
+    reweight_all_teams();
+}
+
+void CostData::build_cost_chains()
+{
+    int numLevels = partition->get_all_team_data()->num_levels();
+    for(int levelNum = 1; levelNum <= numLevels; ++levelNum) {
+	costChains[levelNum].resize(partition->num_teams_at_level(levelNum));
+	EntityListIterator teamItr(partition->teams_at_level_iterator(levelNum));
+	while(!teamItr.done()) {
+	    costChains[levelNum][teamItr->get_index()].start = costChainEntries.size();
+	    fill_cost_chain((TeamLevel*)teamItr);
 	    ++teamItr;
 	}
     }
+    // A move can't pend more costs than there are, so this is as big as the list gets
+    costsToBeUpdatedOnMove.reserve(costChainEntries.size());
+}
+
+void CostData::fill_cost_chain(TeamLevel* team)
+{
+    // Copy the costs of the team and each of its ancestors into the chain. (Every team at a 
+    // level has the same number of costs so an existing chain is overwritten in place.)
+    int levelNum = team->get_level().get_level_num();
+    CostChain& chain = costChains[levelNum][team->get_index()];
+    unsigned int position = chain.start;
+    for(int i = 0; i < levelNum; ++i) {
+	ConstraintCostListIterator costItr(get_costs_for_team(team));
+	while(!costItr.done()) {
+	    CostChainEntry entry = { costItr->get_table(), costItr->get_team_index() };
+	    if(position == costChainEntries.size()) {
+		costChainEntries.push_back(entry);
+	    } else {
+		costChainEntries[position] = entry;
+	    }
+	    ++position;
+	    ++costItr;
+	}
+	chain.levelEnd[i] = position;
+	team = team->get_parent();
+    }
+}
+
+void CostData::refresh_cost_chains(TeamLevel* team)
+{
+    fill_cost_chain(team);
+    if(!team->get_level().is_lowest()) {
+	EntityListIterator childItr = team->child_iterator();
+	while(!childItr.done()) {
+	    refresh_cost_chains((TeamLevel*)childItr);
+	    ++childItr;
+	}
+    }
+}
+
+const CostData::CostChain& CostData::get_cost_chain(const TeamLevel* team) const
+{
+    const vector<CostChain>& chains = costChains[team->get_level().get_level_num()];
+    assert(team->get_index() >= 0 && team->get_index() < (int)chains.size());
+    return chains[team->get_index()];
+}
+
+void CostData::add_to_pending(const CostChainEntry& entry)
+{
+    unsigned long long& entryEpoch = entry.table->pendingEpoch[entry.teamIndex];
+    if(entryEpoch != pendingEpoch) {
+	entryEpoch = pendingEpoch;
+	costsToBeUpdatedOnMove.push_back(entry);
+    }
+}
+
+void CostData::clear_pending()
+{
+    costsToBeUpdatedOnMove.clear();
+    subteamsToBeUpdatedOnMove.clear();
+    ++pendingEpoch;
+}
+
+void CostData::recalculate_constraint_costs()
+{
+    cost = 0;
+    clear_pending();
+    ConditionBitsets conditions(annealInfo, partition);
+    for(unsigned int c = 0; c < constraintCostTables.size(); ++c) {
+	ConstraintCostTable* table = constraintCostTables[c];
+	for(int i = 0; i < table->num_teams(); ++i) {
+	    table->recalculate(i, &conditions);
+	    cost += table->get_cost_units(i);
+	}
+    }
+    costPendingMove = cost;
+    clear_swap_deltas();
+    reweight_all_teams();
+    // Teams may have moved to new parents
+    EntityListIterator teamItr(partition->teams_at_level_iterator(1));
+    while(!teamItr.done()) {
+	refresh_cost_chains((TeamLevel*)teamItr);
+	++teamItr;
+    }
 }
 
 CostData::TeamIterator CostData::team_begin() const
@@ -247,102 +471,395 @@ ConstraintCost* CostData::get_constraint_cost(Constraint* constraint, TeamLevel*
 
 double CostData::get_cost_value() const
 {
-    return cost;
+    return ConstraintCost::from_cost_units(cost);
+}
+
+double CostData::get_cost_value_at_level(int levelNum) const
+{
+    CostUnits levelCost = 0;
+    map<const Constraint*,ConstraintCostList*>::const_iterator constraintListItr = 
+	    constraintToCostListMap.begin();
+    while(constraintListItr != constraintToCostListMap.end()) {
+	if(constraintListItr->first->get_level() == levelNum) {
+	    ConstraintCostListIterator costItr(constraintListItr->second);
+	    while(!costItr.done()) {
+		levelCost += costItr->get_cost_units();
+		++costItr;
+	    }
+	}
+	++constraintListItr;
+    }
+    return ConstraintCost::from_cost_units(levelCost);
+}
+
+double CostData::get_cost_lower_bound() const
+{
+    return ConstraintCost::from_cost_units(costLowerBound);
+}
+
+bool CostData::at_cost_lower_bound() const
+{
+    return cost <= costLowerBound;
+}
+
+unsigned long long CostData::get_num_cost_evaluations() const
+{
+    return numCostEvaluations;
 }
 
 double CostData::get_pending_cost_value() const
 {
-    return costPendingMove;
+    return ConstraintCost::from_cost_units(costPendingMove);
 }
 
-double CostData::pend_remove_member(Member* member)
+double CostData::pend_remove_member(Member* member, TeamLevel* stopTeam)
 {
     // Work out which team this member is in
     TeamLevel* team = member->get_parent();
     assert(team);
 
-    double deltaCost = 0.0;
-    // Iterate over the constraint costs for the team to update their costs
-#if 1
-    while(!team->is_partition()) {
-	ConstraintCostListIterator itr(get_costs_for_team(team));
-	while(!itr.done()) {
-	    deltaCost += itr->pend_remove_member(member);
-	    costsToBeUpdatedOnMove.insert(itr);
-	    ++itr;
+    CostUnits deltaCost = pend_remove_member_from_teams(member, team, 
+	    stopTeam ? stopTeam : partition);
+    costPendingMove += deltaCost;
+    return ConstraintCost::from_cost_units(deltaCost);
+}
+
+
+double CostData::pend_add_member(Member* member, TeamLevel* lowLevelTeam, TeamLevel* stopTeam)
+{
+    CostUnits deltaCost = pend_add_member_to_teams(member, lowLevelTeam, 
+	    stopTeam ? stopTeam : partition);
+    costPendingMove += deltaCost;
+    return ConstraintCost::from_cost_units(deltaCost);
+}
+
+double CostData::min_delta_for_member_changes(TeamLevel* const* teams, int numTeams, 
+	int changesPerTeam, TeamLevel* stopTeam) const
+{
+    if(!stopTeam) {
+	stopTeam = partition;
+    }
+    // Find all the distinct teams affected - the given teams and their ancestors - and the 
+    // number of changes each may see. (Only a few teams are involved so a linear search is fine.)
+    TeamLevel* affectedTeams[MAX_LEVELS * MAX_TEAMS_CHANGED];
+    int numChanges[MAX_LEVELS * MAX_TEAMS_CHANGED];
+    int numAffectedTeams = 0;
+    assert(numTeams <= MAX_TEAMS_CHANGED);
+    for(int i = 0; i < numTeams; ++i) {
+	TeamLevel* team = teams[i];
+	while(team != stopTeam) {
+	    int j = find(affectedTeams, affectedTeams + numAffectedTeams, team) - affectedTeams;
+	    if(j == numAffectedTeams) {
+		affectedTeams[numAffectedTeams] = team;
+		numChanges[numAffectedTeams++] = changesPerTeam;
+	    } else {
+		numChanges[j] += changesPerTeam;
+	    }
+	    team = team->get_parent();
 	}
-	team = team->get_parent();
     }
-#else
-    ConstraintCostList* costsForTeam = get_costs_for_team(team);
-    if(costsForTeam) {
-	for(int i=costsForTeam->size() - 1; i >= 0; --i) {
-	    deltaCost += (*costsForTeam)[i]->pend_remove_member(member);
-	    costsToBeUpdatedOnMove.insert((*costsForTeam)[i]);
+    double minDelta = 0.0;
+    for(int i = 0; i < numAffectedTeams; ++i) {
+	// The team's own costs are at the start of its chain
+	const CostChain& chain = get_cost_chain(affectedTeams[i]);
+	for(int j = chain.start; j < chain.levelEnd[0]; ++j) {
+	    const CostChainEntry& entry = costChainEntries[j];
+	    minDelta += entry.table->min_delta_for_member_changes(entry.teamIndex, numChanges[i]);
 	}
     }
-#endif
+    return minDelta;
+}
+
+double CostData::pend_move_subteam(TeamLevel* subteam, TeamLevel* newParent)
+{
+    CostUnits deltaCost = pend_move_subteam_units(subteam, newParent);
     costPendingMove += deltaCost;
-    return deltaCost;
+    return ConstraintCost::from_cost_units(deltaCost);
 }
 
+CostUnits CostData::pend_move_subteam_units(TeamLevel* subteam, TeamLevel* newParent)
+{
+    TeamLevel* oldParent = subteam->get_parent();
+    assert(oldParent && oldParent != newParent);
+    // Costs at and above the lowest common ancestor of the old and new parents are unaffected
+    TeamLevel* commonAncestor = oldParent->common_ancestor(newParent);
+
+    subteamsToBeUpdatedOnMove.push_back(subteam);
+    CostUnits deltaCost = 0;
+    MemberIterator memberItr = subteam->member_iterator();
+    while(!memberItr.done()) {
+	deltaCost += pend_remove_member_from_teams(memberItr, oldParent, commonAncestor);
+	deltaCost += pend_add_member_to_teams(memberItr, newParent, commonAncestor);
+	++memberItr;
+    }
+    return deltaCost;
+}
 
-double CostData::pend_add_member(Member* member, TeamLevel* lowLevelTeam)
+CostUnits CostData::pend_remove_member_from_teams(Member* member, TeamLevel* team, TeamLevel* stopTeam)
 {
-    double deltaCost = 0.0;
-    TeamLevel* team = lowLevelTeam;
-    // Iterate over the constraint costs for the team to update their costs
-#if 1
-    while(!team->is_partition()) {
-	ConstraintCostListIterator itr(get_costs_for_team(team));
-	while(!itr.done()) {
-	    deltaCost += itr->pend_add_member(member);
-	    costsToBeUpdatedOnMove.insert(itr);
-	    ++itr;
-	}
-	team = team->get_parent();
+    // Iterate over the constraint costs for the team (and its ancestors below stopTeam) to 
+    // update their costs
+    const CostChain& chain = get_cost_chain(team);
+    int end = chain.levelEnd[team->get_level().get_level_num() - 
+	    stopTeam->get_level().get_level_num() - 1];
+    CostUnits deltaCost = 0;
+    for(int i = chain.start; i < end; ++i) {
+	const CostChainEntry& entry = costChainEntries[i];
+	deltaCost += entry.table->pend_remove_member(entry.teamIndex, member);
+	add_to_pending(entry);
     }
-#else
-    ConstraintCostList* costsForTeam = get_costs_for_team(lowLevelTeam);
-    if(costsForTeam) {
-	for(int i=costsForTeam->size() - 1; i >= 0; --i) {
-	    deltaCost += (*costsForTeam)[i]->pend_add_member(member);
-	    costsToBeUpdatedOnMove.insert((*costsForTeam)[i]);
-	}
+    numCostEvaluations += end - chain.start;
+    return deltaCost;
+}
+
+CostUnits CostData::pend_add_member_to_teams(Member* member, TeamLevel* team, TeamLevel* stopTeam)
+{
+    // Iterate over the constraint costs for the team (and its ancestors below stopTeam) to 
+    // update their costs
+    const CostChain& chain = get_cost_chain(team);
+    int end = chain.levelEnd[team->get_level().get_level_num() - 
+	    stopTeam->get_level().get_level_num() - 1];
+    CostUnits deltaCost = 0;
+    for(int i = chain.start; i < end; ++i) {
+	const CostChainEntry& entry = costChainEntries[i];
+	deltaCost += entry.table->pend_add_member(entry.teamIndex, member);
+	add_to_pending(entry);
     }
-#endif
-    costPendingMove += deltaCost;
+    numCostEvaluations += end - chain.start;
     return deltaCost;
 }
 
 void CostData::commit_pending()
 {
-    // Iterate over all the pending cost changes and apply them
-    unordered_set<ConstraintCost*>::iterator itr = costsToBeUpdatedOnMove.begin();
-    while(itr != costsToBeUpdatedOnMove.end()) {
-	(*itr)->commit_pending();
-	++itr;
+    // Iterate over all the pending cost changes and apply them (noting which teams changed)
+    ++commitCount;
+    for(unsigned int i = 0; i < costsToBeUpdatedOnMove.size(); ++i) {
+	const CostChainEntry& entry = costsToBeUpdatedOnMove[i];
+	entry.table->commit_pending(entry.teamIndex);
+	const TeamLevel* team = entry.table->get_team(entry.teamIndex);
+	unsigned long long& lastCommit = 
+		teamLastCommit[team->get_level().get_level_num()][team->get_index()];
+	if(teamCostWeightsEnabled && lastCommit != commitCount && team->get_level().is_lowest()) {
+	    teamsToReweight.push_back((TeamLevel*)team);
+	}
+	lastCommit = commitCount;
+    }
+    for(unsigned int i = 0; i < teamsToReweight.size(); ++i) {
+	reweight_team(teamsToReweight[i]);
+    }
+    teamsToReweight.clear();
+    // Moved subteams (and the teams below them) have new ancestors
+    for(unsigned int i = 0; i < subteamsToBeUpdatedOnMove.size(); ++i) {
+	refresh_cost_chains(subteamsToBeUpdatedOnMove[i]);
     }
     // Clear list of pending moves
-    costsToBeUpdatedOnMove.clear();
+    clear_pending();
     // Update overall cost
     cost = costPendingMove;
 }
 
+void CostData::enable_team_cost_weights()
+{
+    teamCostWeightsEnabled = true;
+    reweight_all_teams();
+}
+
+bool CostData::has_team_cost_weights() const
+{
+    return teamCostWeightsEnabled && teamCostWeights.total() > 0;
+}
+
+void CostData::reweight_team(const TeamLevel* team)
+{
+    // The team's own costs are at the start of its chain
+    const CostChain& chain = get_cost_chain(team);
+    CostUnits teamCost = 0;
+    for(int i = chain.start; i < chain.levelEnd[0]; ++i) {
+	teamCost += costChainEntries[i].table->get_cost_units(costChainEntries[i].teamIndex);
+    }
+    teamCostWeights.set(team->get_index(), teamCost);
+}
+
+void CostData::reweight_all_teams()
+{
+    if(!teamCostWeightsEnabled) {
+	return;
+    }
+    teamCostWeights.reset(partition->num_teams_at_lowest_level());
+    EntityListIterator teamItr(partition->teams_at_lowest_level_iterator());
+    while(!teamItr.done()) {
+	reweight_team((TeamLevel*)teamItr);
+	++teamItr;
+    }
+}
+
+TeamLevel* CostData::find_team_by_cost_weight(double fraction) const
+{
+    assert(teamCostWeightsEnabled && teamCostWeights.total() > 0);
+    long long amount = min((long long)(fraction * teamCostWeights.total()), 
+	    teamCostWeights.total() - 1);
+    int levelNum = partition->get_all_team_data()->num_levels();
+    return partition->get_team_at_level(levelNum, teamCostWeights.find(amount));
+}
+
+double CostData::team_cost_weight_share(const TeamLevel* team) const
+{
+    assert(has_team_cost_weights());
+    return (double)teamCostWeights.get(team->get_index()) / teamCostWeights.total();
+}
+
+CostUnits CostData::get_pending_team_cost_weight(const TeamLevel* team) const
+{
+    assert(teamCostWeightsEnabled && team->get_level().is_lowest());
+    // The team's own costs are at the start of its chain
+    const CostChain& chain = get_cost_chain(team);
+    CostUnits teamCost = 0;
+    for(int i = chain.start; i < chain.levelEnd[0]; ++i) {
+	teamCost += costChainEntries[i].table->get_pending_cost_units(costChainEntries[i].teamIndex);
+    }
+    return teamCost;
+}
+
+CostUnits CostData::get_pending_team_cost_weights_total() const
+{
+    assert(teamCostWeightsEnabled);
+    // Only the costs with pending changes can differ from their weights
+    CostUnits total = teamCostWeights.total();
+    for(unsigned int i = 0; i < costsToBeUpdatedOnMove.size(); ++i) {
+	const CostChainEntry& entry = costsToBeUpdatedOnMove[i];
+	if(entry.table->get_team(entry.teamIndex)->get_level().is_lowest()) {
+	    total += entry.table->get_pending_cost_units(entry.teamIndex) - 
+		    entry.table->get_cost_units(entry.teamIndex);
+	}
+    }
+    return total;
+}
+
+int CostData::get_signature(const Member* member) const
+{
+    return memberSignatures[member->get_index()];
+}
+
+void CostData::clear_swap_deltas()
+{
+    swapDeltaCache.assign(1 << SWAP_DELTA_CACHE_BITS, SwapDelta{nullptr, nullptr, -1, -1, 0, 0.0});
+    int numLevels = partition->get_all_team_data()->num_levels();
+    for(int levelNum = 1; levelNum <= numLevels; ++levelNum) {
+	teamLastCommit[levelNum].assign(partition->num_teams_at_level(levelNum), 0);
+    }
+}
+
+CostData::SwapDelta& CostData::get_swap_delta_entry(const Member* member1, const Member* member2,
+	SwapDelta& key)
+{
+    key.team1 = member1->get_parent();
+    key.team2 = member2->get_parent();
+    key.signature1 = get_signature(member1);
+    key.signature2 = get_signature(member2);
+    if(key.team1->get_index() > key.team2->get_index()) {
+	swap(key.team1, key.team2);
+	swap(key.signature1, key.signature2);
+    }
+    unsigned int hash = key.team1->get_index();
+    hash = hash * 31 + key.team2->get_index();
+    hash = hash * 31 + key.signature1;
+    hash = hash * 31 + key.signature2;
+    return swapDeltaCache[(hash * 2654435769u) >> (32 - SWAP_DELTA_CACHE_BITS)];
+}
+
+bool CostData::unchanged_since(const TeamLevel* team, unsigned long long commitNumber) const
+{
+    while(!team->is_partition()) {
+	if(teamLastCommit[team->get_level().get_level_num()][team->get_index()] > commitNumber) {
+	    return false;
+	}
+	team = team->get_parent();
+    }
+    return true;
+}
+
+bool CostData::find_swap_delta(const Member* member1, const Member* member2, double& deltaCost)
+{
+    if(swapDeltaBypassRemaining > 0) {
+	--swapDeltaBypassRemaining;
+	return false;
+    }
+    if(++swapDeltaLookups == SWAP_DELTA_SAMPLE_SIZE) {
+	// Bypass the cache for a while if it isn't paying off
+	if(swapDeltaHits * SWAP_DELTA_MIN_HIT_RATIO < swapDeltaLookups) {
+	    swapDeltaBypassRemaining = SWAP_DELTA_BYPASS_LENGTH;
+	}
+	swapDeltaLookups = 0;
+	swapDeltaHits = 0;
+    }
+    SwapDelta key;
+    const SwapDelta& entry = get_swap_delta_entry(member1, member2, key);
+    if(entry.team1 != key.team1 || entry.team2 != key.team2 || 
+	    entry.signature1 != key.signature1 || entry.signature2 != key.signature2 ||
+	    !unchanged_since(key.team1, entry.commitNumber) || 
+	    !unchanged_since(key.team2, entry.commitNumber)) {
+	return false;
+    }
+    deltaCost = entry.deltaCost;
+    ++swapDeltaHits;
+    return true;
+}
+
+void CostData::save_swap_delta(const Member* member1, const Member* member2, double deltaCost)
+{
+    if(swapDeltaBypassRemaining > 0) {
+	return;
+    }
+    SwapDelta key;
+    SwapDelta& entry = get_swap_delta_entry(member1, member2, key);
+    entry = key;
+    entry.commitNumber = commitCount;
+    entry.deltaCost = deltaCost;
+}
+
 void CostData::undo_pending()
 {
     // Iterate over all the pending cost changes and undo them
-    unordered_set<ConstraintCost*>::iterator itr = costsToBeUpdatedOnMove.begin();
-    while(itr != costsToBeUpdatedOnMove.end()) {
-	(*itr)->undo_pending();
-	++itr;
+    for(unsigned int i = 0; i < costsToBeUpdatedOnMove.size(); ++i) {
+	costsToBeUpdatedOnMove[i].table->undo_pending(costsToBeUpdatedOnMove[i].teamIndex);
     }
     // Clear list of pending moves
-    costsToBeUpdatedOnMove.clear();
+    clear_pending();
     // Restore the cost pending any moves
     costPendingMove = cost;
 }
 
+void CostData::restore_lowest_cost_teams()
+{
+    // Undo the changes one at a time - each is treated like a move so that the costs are kept
+    // up to date without recalculating them from scratch
+    assert(costsToBeUpdatedOnMove.empty());
+    if(partition->num_changes_since_lowest_cost() > partition->num_members()) {
+	// Quicker to restore the teams and then recalculate each cost once
+	partition->restore_lowest_cost_teams();
+	recalculate_constraint_costs();
+	return;
+    }
+    while(partition->num_changes_since_lowest_cost() > 0) {
+	const Partition::TeamChange& change = partition->last_change_since_lowest_cost();
+	if(change.entity->is_member()) {
+	    Member* member = (Member*)change.entity;
+	    TeamLevel* commonAncestor = member->get_parent()->common_ancestor(change.team);
+	    costPendingMove += pend_remove_member_from_teams(member, member->get_parent(), 
+		    commonAncestor);
+	    costPendingMove += pend_add_member_to_teams(member, change.team, commonAncestor);
+	} else {
+	    TeamLevel* team1 = (TeamLevel*)change.entity;
+	    TeamLevel* team2 = change.team;
+	    TeamLevel* parent1 = team1->get_parent();
+	    costPendingMove += pend_move_subteam_units(team1, team2->get_parent());
+	    costPendingMove += pend_move_subteam_units(team2, parent1);
+	}
+	partition->undo_last_change();
+	commit_pending();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // AllCostData
 
@@ -9,9 +9,10 @@
 #include "constraintCostList.hh"
 #include "entity.hh"
 #include "constraint.hh"
+#include "fenwickTree.hh"
 #include <map>
 #include <ostream>
-#include <unordered_set>
+#include <vector>
 
 // Global data
 class AllCostData;
@@ -30,6 +31,7 @@ void output_cost_data(ostream& os, Partition* partition = nullptr);
 
 class CostData {
 public:
+    static const int MAX_TEAMS_CHANGED = 8;	// for min_delta_for_member_changes()
     AnnealInfo& annealInfo;
     Partition* partition;
     typedef map<const TeamLevel*,ConstraintCost*> TeamToCostMap;
@@ -37,20 +39,119 @@ public:
 private:
     map<const TeamLevel*,ConstraintCostList*>	teamToCostListMap;
     map<const Constraint*,ConstraintCostList*> constraintToCostListMap;
-    double cost;
-    double costPendingMove;
-    unordered_set<ConstraintCost*> costsToBeUpdatedOnMove;
+    // The state of every team's cost for each constraint is kept in one table per constraint 
+    // (indexed by constraint number). The ConstraintCost objects in the lists/maps refer into 
+    // these.
+    vector<ConstraintCostTable*> constraintCostTables;
+    CostUnits cost;		// always the sum of the individual constraint costs
+    CostUnits costPendingMove;
+    // Sum of the lower bounds on each constraint's cost - no teams can cost less than this
+    CostUnits costLowerBound;
+
+    // For each team (indexed by level number then team index) the constraint costs of the team 
+    // and its ancestors, as a range of costChainEntries. The team's own costs come first, then
+    // its parent's etc. levelEnd[i] is the end of the range covering the team and i ancestors.
+    // (Chains of teams below a moved subteam are refreshed when the move is committed.)
+    struct CostChain {
+	int start;
+	int levelEnd[MAX_LEVELS];
+    };
+    // A team's cost for one constraint - the entry in the constraint's table
+    struct CostChainEntry {
+	ConstraintCostTable* table;
+	int teamIndex;
+    };
+    vector<CostChainEntry> costChainEntries;
+    vector<CostChain> costChains[MAX_LEVELS + 1];
+
+    // Constraint costs with pending changes. A cost is added the first time it is pended in each
+    // epoch (the epoch advances on every commit/undo) so no cost appears twice.
+    vector<CostChainEntry> costsToBeUpdatedOnMove;
+    unsigned long long pendingEpoch;
+    vector<TeamLevel*> subteamsToBeUpdatedOnMove;	// subteams with pending moves
+    unsigned long long numCostEvaluations;	// number of constraint costs pended so far
+
+    // Members which look the same to every constraint (same conditions met and same attribute
+    // values) have the same signature. Indexed by member index.
+    vector<int> memberSignatures;
+
+    // Delta costs of member swaps, memoised by the teams and member signatures involved. An 
+    // entry is valid only if no costs of either team or their ancestors have been committed 
+    // since it was saved. (commitCount is incremented on every commit and teamLastCommit
+    // records, for each team indexed by level number then team index, the last commit that
+    // changed any of its costs.) The cache is direct mapped - new entries replace old ones.
+    struct SwapDelta {
+	const TeamLevel* team1;
+	const TeamLevel* team2;
+	int signature1;		// of the member leaving team1
+	int signature2;		// of the member leaving team2
+	unsigned long long commitNumber;
+	double deltaCost;
+    };
+    static const int SWAP_DELTA_CACHE_BITS = 12;	// log2 of the number of entries
+    vector<SwapDelta> swapDeltaCache;
+    unsigned long long commitCount;
+    vector<unsigned long long> teamLastCommit[MAX_LEVELS + 1];
+    // Lookups are only worthwhile when the teams are changing slowly (e.g. at low temperature).
+    // If fewer than 1 in SWAP_DELTA_MIN_HIT_RATIO of a sample of lookups hit, the cache is
+    // bypassed for the next SWAP_DELTA_BYPASS_LENGTH swaps.
+    static const int SWAP_DELTA_SAMPLE_SIZE = 4096;
+    static const int SWAP_DELTA_MIN_HIT_RATIO = 16;
+    static const int SWAP_DELTA_BYPASS_LENGTH = 65536;
+    int swapDeltaLookups;
+    int swapDeltaHits;
+    int swapDeltaBypassRemaining;
+
+    // Cost (in cost units) of the constraints of each lowest level team (indexed by team index)
+    // for cost guided move proposals. Only maintained once enable_team_cost_weights() has been
+    // called. Teams whose costs changed in a commit are reweighted after the commit.
+    bool teamCostWeightsEnabled;
+    FenwickTree teamCostWeights;
+    vector<TeamLevel*> teamsToReweight;
 
     // This map allows us to map from a constraint to a sub-map and then within that
     // map from a team to an individual constraint cost
     map<const Constraint*,TeamToCostMap*> constraintToTeamCostMap;
 
     void add_constraint_cost(ConstraintCost* constraintCost);
+    // Work out the lower bound on the cost from partition wide counts (these don't change as
+    // members move so this is only done once)
+    void compute_cost_lower_bound();
+    void assign_member_signatures();
+    void clear_swap_deltas();
+    // Find the cache entry for a swap of the given members (ordered so that a swap has the same
+    // entry whichever member is given first)
+    SwapDelta& get_swap_delta_entry(const Member* member1, const Member* member2, 
+	    SwapDelta& key);
+    bool unchanged_since(const TeamLevel* team, unsigned long long commitNumber) const;
+    void reweight_team(const TeamLevel* team);
+    void reweight_all_teams();
+    void delete_constraint_costs();
+    void build_cost_chains();
+    void fill_cost_chain(TeamLevel* team);		// from the team's current ancestors
+    void refresh_cost_chains(TeamLevel* team);	// for the team and all teams below it
+    const CostChain& get_cost_chain(const TeamLevel* team) const;
+    void add_to_pending(const CostChainEntry& entry);
+    void clear_pending();
+    // Pend the removal/addition of the member from/to the given team and its ancestors, stopping
+    // before stopTeam (which may be the partition). These (and pend_move_subteam_units()) return 
+    // the delta cost but leave it to the caller to update costPendingMove.
+    CostUnits pend_remove_member_from_teams(Member* member, TeamLevel* team, TeamLevel* stopTeam);
+    CostUnits pend_add_member_to_teams(Member* member, TeamLevel* team, TeamLevel* stopTeam);
+    CostUnits pend_move_subteam_units(TeamLevel* subteam, TeamLevel* newParent);
 public:
     // Constructor
     CostData(AnnealInfo& annealInfo, Partition* partition);
 
+    // Destructor
+    ~CostData();
+
+    // Rebuild all the constraint costs from the current teams. Costs are maintained exactly as
+    // moves are made so this is only needed when the teams are (re)created.
     void initialise_constraint_costs();
+    // Recalculate the existing constraint costs from the current teams (which must have the
+    // same structure as when the costs were initialised)
+    void recalculate_constraint_costs();
 
     TeamIterator team_begin() const;
     TeamIterator team_end() const;
@@ -64,14 +165,57 @@ public:
 
     double get_cost_value() const;
     double get_pending_cost_value() const;
+    // Total cost of the constraints which apply at the given level
+    double get_cost_value_at_level(int levelNum) const;
+    // Lower bound on the cost of any teams for this partition (may be well below the lowest
+    // cost achievable). An anneal can stop once the cost reaches it.
+    double get_cost_lower_bound() const;
+    bool at_cost_lower_bound() const;
+    // Number of times a member change has been evaluated by a constraint cost (a measure of the
+    // work done evaluating moves)
+    unsigned long long get_num_cost_evaluations() const;
+
+    // Maintain the costs of each lowest level team's own constraints so that teams can be chosen
+    // in proportion to them
+    void enable_team_cost_weights();
+    bool has_team_cost_weights() const;	// true if the total of the weights isn't 0
+    // Lowest level team which covers the given fraction (0 to 1) of the total of the team cost
+    // weights (which must not be 0)
+    TeamLevel* find_team_by_cost_weight(double fraction) const;
+    // Team's share (0 to 1) of the total of the team cost weights (which must not be 0)
+    double team_cost_weight_share(const TeamLevel* team) const;
+    // Team cost weight of the given lowest level team, and the total of the weights, as they
+    // will be once the pending changes are committed
+    CostUnits get_pending_team_cost_weight(const TeamLevel* team) const;
+    CostUnits get_pending_team_cost_weights_total() const;
+
+    // Members with the same signature are interchangeable as far as the costs are concerned
+    int get_signature(const Member* member) const;
+    // Look up the delta cost of swapping the given members (in different lowest level teams)
+    // if it is known. save_swap_delta() records the delta cost of a fully evaluated swap.
+    bool find_swap_delta(const Member* member1, const Member* member2, double& deltaCost);
+    void save_swap_delta(const Member* member1, const Member* member2, double deltaCost);
 
     // Queue a potential move - returns the delta cost of this move (negative is better).
-    // Updates the list of pending moves
-    double pend_remove_member(Member* member);
-    double pend_add_member(Member* member, TeamLevel* lowLevelTeam);
+    // Updates the list of pending moves. Only the costs of the team and its ancestors below
+    // stopTeam are updated (nullptr means all ancestors). If members only move between teams 
+    // below a common ancestor then the costs at and above it are unchanged and can be skipped.
+    double pend_remove_member(Member* member, TeamLevel* stopTeam = nullptr);
+    double pend_add_member(Member* member, TeamLevel* lowLevelTeam, TeamLevel* stopTeam = nullptr);
+    // Lower bound on the change in pending cost if each of the given lowest level teams has up 
+    // to the given number of members added or removed (which also changes their ancestors
+    // below stopTeam).
+    double min_delta_for_member_changes(TeamLevel* const* teams, int numTeams, 
+	    int changesPerTeam, TeamLevel* stopTeam = nullptr) const;
+    // Queue a move of a team (and all its members) to a new parent team at the same level as its
+    // current parent. Only the costs of the ancestors below the common ancestor are affected.
+    double pend_move_subteam(TeamLevel* subteam, TeamLevel* newParent);
     // Commit/undo the pending changes
     void commit_pending();		// This should be done AFTER actual team changes
     void undo_pending();
+
+    // Restore the partition's lowest cost teams, updating the costs for each change undone
+    void restore_lowest_cost_teams();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -33,7 +33,7 @@ void extract_people_and_attributes_from_csv_data(AnnealInfo& annealInfo, CSV_Fil
     for(int row=0; row<data->num_rows(); row++) {
 	// Find the ID of this person and create the empty person object
         string& id = data->rows[row]->cells[idFieldNum]->str;
-        Person* person = new Person(id);
+        Person* person = new Person(id, row);
 
 	// For each column in the CSV file, add this data as an attribute 
 	// to our person - either a string attribute or a numerical attribute
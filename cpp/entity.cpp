@@ -9,7 +9,6 @@
 #include <exception>
 #include "assert.h"
 #include "exceptions.hh"
-#include <ctime>
 
 static string emptyString("");
 
@@ -21,7 +20,9 @@ Entity::Entity(Entity::Type type, Partition* partition) :
 	type(type),
 	name(emptyString),
 	parent(nullptr),	// no parent by default
-	partition(partition)
+	partition(partition),
+	positionInParent(-1),
+	index(-1)
 {
 }
 
@@ -77,6 +78,11 @@ bool Entity::has_parent() const
     return (parent != nullptr);
 }
 
+int Entity::get_index() const
+{
+    return index;
+}
+
 bool Entity::is_member() const
 {
     return (type == Entity::MEMBER);
@@ -172,15 +178,6 @@ bool Member::is_condition_met(int constraintNumber) const
 // TeamLevel
 
 // Constructors
-// Pseudo-copy constructor
-TeamLevel::TeamLevel(const TeamLevel* team, bool setMemberParents) :
-	Entity(Entity::TEAM, team->name, team->partition),
-	children(team->children, this, setMemberParents),
-	level(team->level),
-	fullTeamName(team->fullTeamName)
-{
-}
-
 TeamLevel::TeamLevel(const Level& level, Partition* partition) :
 	Entity(Entity::TEAM, partition),
 	level(level)
@@ -196,14 +193,27 @@ TeamLevel::TeamLevel(const Level& level, const string& teamName, Partition* part
 
 void TeamLevel::add_child(Entity* child) 
 {
+    child->positionInParent = children.size();
     children.append(child);
     child->set_parent(this);
 }
 
 void TeamLevel::remove_child(Entity* child)
 {
-    children.remove(child);
+    assert(child->parent == this);
+    Entity* moved = children.remove_at(child->positionInParent);
+    if(moved) {
+	moved->positionInParent = child->positionInParent;
+    }
     child->set_parent(nullptr);
+    child->positionInParent = -1;
+}
+
+void TeamLevel::replace_child_at(int position, Entity* replacement)
+{
+    children.replace_at(position, replacement);
+    replacement->set_parent(this);
+    replacement->positionInParent = position;
 }
 
 const Level& TeamLevel::get_level() const
@@ -233,9 +243,26 @@ int TeamLevel::size() const
 
 int TeamLevel::find_index_of(Entity* child)
 {
-    int index = children.find_index_of(child);
-    assert(index != -1);	// Must be found
-    return index;
+    assert(child->parent == this);	// Must be found
+    return child->positionInParent;
+}
+
+TeamLevel* TeamLevel::common_ancestor(TeamLevel* other)
+{
+    // Move up from the lower team until both are at the same level then move up both paths in
+    // step
+    TeamLevel* ancestor = this;
+    while(ancestor->get_level().get_level_num() > other->get_level().get_level_num()) {
+	ancestor = ancestor->get_parent();
+    }
+    while(other->get_level().get_level_num() > ancestor->get_level().get_level_num()) {
+	other = other->get_parent();
+    }
+    while(ancestor != other) {
+	ancestor = ancestor->get_parent();
+	other = other->get_parent();
+    }
+    return ancestor;
 }
 
 void TeamLevel::output(ostream& os) const
@@ -270,20 +297,13 @@ const string& TeamLevel::get_full_team_name() const
 // Partition
 
 // Constructor
-Partition::Partition(AllTeamData* allTeamData, const Level& level, const string& name, int numPeople) :
+Partition::Partition(AllTeamData* allTeamData, const Level& level, const string& name, int numPeople,
+		unsigned int partitionNum, unsigned int copyNum) :
 	TeamLevel(level, name, this),
 	allTeamData(allTeamData),
-	lowestCostTopLevelTeams(nullptr),
-#ifdef CONSTANT_RANDOM_SEED
-	randomNumberGenerator(0),
-#else
-	randomNumberGenerator(time(nullptr)),		// Seed RN generator with current time
-#endif
-	memberRandomDistribution(0,numPeople-1),	// Random number distribution 0 to numPeople - 1
-	teamRandomDistribution(0,0),			// We'll reset the bounds of this later when we
-							// know how many teams there are
-	memberdice(bind(memberRandomDistribution,randomNumberGenerator)),
-	teamdice(bind(teamRandomDistribution,randomNumberGenerator))
+	lowestCostTeamsRecorded(false),
+	partitionNum(partitionNum),
+	randomNumberGenerator(RandomGenerator::PARTITION, partitionNum, copyNum)
 {
     type = Entity::PARTITION;	// override default TEAM
     allMembers.reserve(numPeople);
@@ -294,6 +314,29 @@ Partition::Partition(AllTeamData* allTeamData, const Level& level, const string&
     teamsAtLowestLevel = teamsAtEachLevel[allTeamData->num_levels()];
 }
 
+// Destructor
+Partition::~Partition()
+{
+    // Top level teams are in both our list of children and the level 1 list - make sure they are 
+    // only deleted once. Deleting a team deletes all of its sub teams, so lower level lists are 
+    // cleared before being deleted.
+    children.clear();
+    delete teamsAtEachLevel[1];
+    for(int i = 2; i <= allTeamData->num_levels(); i++) {
+	teamsAtEachLevel[i]->clear();
+	delete teamsAtEachLevel[i];
+    }
+
+    // EntityLists don't delete members - do that here
+    EntityListIterator itr(allMembers);
+    while(!itr.done()) {
+	delete (Member*)itr;
+	++itr;
+    }
+    allMembers.clear();
+    unallocatedMembers.clear();
+}
+
 // Other member functions
 
 Attribute* Partition::get_partition_attribute() const
@@ -304,6 +347,7 @@ Attribute* Partition::get_partition_attribute() const
 Member* Partition::add_person(const Person* person)
 {
     Member* member = new Member(*person, this);
+    member->index = allMembers.size();
     allMembers.append(member);
     personToMemberMap.insert(pair<const Person*,Member*>(person, member));
     return member;
@@ -321,6 +365,11 @@ int Partition::num_members() const
     return allMembers.size();
 }
 
+unsigned int Partition::get_partition_number() const
+{
+    return partitionNum;
+}
+
 void Partition::clear()
 {
     // Remove teams at the top level - this does not destroy the members, we keep pointers
@@ -339,6 +388,10 @@ void Partition::clear()
 	teamsAtEachLevel[i]->clear();
     }
     teamsAtLowestLevel = teamsAtEachLevel[allTeamData->num_levels()];
+
+    // Any record of the lowest cost teams refers to the teams we've just destroyed
+    changesSinceLowestCost.clear();
+    lowestCostTeamsRecorded = false;
 }
 
 void Partition::populate_random_teams()
@@ -349,8 +402,12 @@ void Partition::populate_random_teams()
 
     // Work out our lowest level - use a reverse iterator.
     vector<Level*>::const_reverse_iterator levelItr = allLevels.rbegin(); 
+    // Put the members in a random order so that each call gives different initial teams
+    EntityList shuffledMembers(allMembers);
+    shuffledMembers.shuffle(randomNumberGenerator);
+
     // Iterate over all the levels (from the bottom up) and create our teams at each level
-    EntityList* membersToPutInTeams = &allMembers;
+    EntityList* membersToPutInTeams = &shuffledMembers;
     do {
 	int levelNum = (*levelItr)->get_level_num();
 	// Work out how many teams we need
@@ -363,8 +420,9 @@ void Partition::populate_random_teams()
 	// for now
 	for(int i = 0; i < numTeams; i++) {
 	    TeamLevel* team = new TeamLevel(**levelItr, this);
-	    teamsAtEachLevel[levelNum]->append(team);
+	    add_team_at_level(team, levelNum);
 	    team->set_parent(this);
+	    team->positionInParent = i;	// teams at level 1 will be our children in this order
 	}
 	// Iterate over all the teams/members at the level below and put them in teams
 	// at this level
@@ -379,7 +437,6 @@ void Partition::populate_random_teams()
 
     // Set the children of this partition as the teams at level 1 - we copy the list (shallow copy)
     children = *(teamsAtEachLevel[1]);
-    reset_random_team_distribution();
 }
 
 void Partition::populate_existing_teams()
@@ -434,7 +491,7 @@ void Partition::populate_existing_teams()
 		    teamAtLevel->set_full_team_name(fullTeamName);
 		}
 		// Add team to the list of teams at this level
-		teamsAtEachLevel[levelNum]->append(teamAtLevel);
+		add_team_at_level(teamAtLevel, levelNum);
 		// Insert team into the hierarchy
 		parent->add_child(teamAtLevel);
 	    } else {
@@ -449,64 +506,139 @@ void Partition::populate_existing_teams()
 	    teamAtLevel->add_child(allMembers[i]);
 	}
     }
-    reset_random_team_distribution();
 }
 
 void Partition::restore_lowest_cost_teams()
 {
+    while(num_changes_since_lowest_cost() > 0) {
+	undo_last_change();
+    }
+}
+
+int Partition::num_changes_since_lowest_cost() const
+{
+    // The journal refers to our current team objects - they must not have been rebuilt
+    assert(lowestCostTeamsRecorded);
+    return changesSinceLowestCost.size();
+}
+
+const Partition::TeamChange& Partition::last_change_since_lowest_cost() const
+{
+    assert(!changesSinceLowestCost.empty());
+    return changesSinceLowestCost.back();
+}
+
+void Partition::undo_last_change()
+{
+    const TeamChange& change = last_change_since_lowest_cost();
+    if(change.entity->is_member()) {
+	// Put the member back in the team it was removed from
+	Member* member = (Member*)change.entity;
+	if(member->has_parent()) {
+	    member->get_parent()->remove_child(member);
+	}
+	change.team->add_child(member);
+    } else {
+	// A subteam swap is its own inverse
+	exchange_subteams((TeamLevel*)change.entity, change.team);
+    }
+    changesSinceLowestCost.pop_back();
+}
+
+void Partition::copy_teams_from(Partition* other)
+{
+    assert(other->num_members() == num_members());
     this->clear();
 
-    // Copy the list. This is a recursive semi-deep copy - teams are copied, but members are not copied.
-    // The "true" argument at the end ensures that the parents of any members are updated to their 
-    // new (copied) teams
-    EntityList* newTeams = new EntityList(*lowestCostTopLevelTeams, this, true);
-    // Shallow copy to the children of this partition
-    children = *newTeams;
-
-    // Update the list of teams at each level
-    *(teamsAtEachLevel[1]) = children;
-    int level = 1;
-    while(level < allTeamData->num_levels()) {
-	// Iterate over all the teams at the current level add lower level teams to their list
-	EntityListIterator itr(*(teamsAtEachLevel[level]));
-	while(!itr.done()) {
-	    EntityListIterator childItr = ((TeamLevel*)itr)->child_iterator();
-	    while(!childItr.done()) {
-		teamsAtEachLevel[level+1]->append((Entity*)childItr);
-		++childItr;
+    // Work from the top level down, creating a copy of each team and inserting it in the
+    // hierarchy under the copy of its parent
+    map<const TeamLevel*,TeamLevel*> teamCopies;
+    for(int levelNum = 1; levelNum <= allTeamData->num_levels(); levelNum++) {
+	EntityListIterator teamItr(*(other->teamsAtEachLevel[levelNum]));
+	while(!teamItr.done()) {
+	    TeamLevel* team = (TeamLevel*)teamItr;
+	    TeamLevel* teamCopy = new TeamLevel(team->get_level(), team->get_name(), this);
+	    teamCopy->set_full_team_name(team->get_full_team_name());
+	    add_team_at_level(teamCopy, levelNum);
+	    teamCopies.insert(pair<const TeamLevel*,TeamLevel*>(team, teamCopy));
+	    if(team->get_parent()->is_partition()) {
+		this->add_child(teamCopy);
+	    } else {
+		teamCopies[team->get_parent()]->add_child(teamCopy);
 	    }
-	    ++itr;
+	    ++teamItr;
+	}
+    }
+    // Put our members in the copies of the lowest level teams
+    EntityListIterator teamItr(*(other->teamsAtLowestLevel));
+    while(!teamItr.done()) {
+	TeamLevel* team = (TeamLevel*)teamItr;
+	TeamLevel* teamCopy = teamCopies[team];
+	EntityListIterator memberItr = team->child_iterator();
+	while(!memberItr.done()) {
+	    teamCopy->add_child(get_member_for_person(&(((Member*)memberItr)->get_person())));
+	    ++memberItr;
 	}
-	++level;
+	++teamItr;
     }
+}
 
-    reset_random_team_distribution();
+Partition* Partition::create_replica(unsigned int copyNum)
+{
+    Partition* replica = new Partition(allTeamData, level, name, num_members(), partitionNum,
+	    copyNum);
+    // Add the same people in the same order
+    EntityListIterator memberItr(allMembers);
+    while(!memberItr.done()) {
+	replica->add_person(&(((Member*)memberItr)->get_person()));
+	++memberItr;
+    }
+    replica->copy_teams_from(this);
+    replica->set_current_teams_as_lowest_cost();
+    return replica;
 }
 
 void Partition::set_current_teams_as_lowest_cost()
 {
-    if(lowestCostTopLevelTeams) {
-	// Delete the whole hierarchy of cloned teams and members
-	delete lowestCostTopLevelTeams;
-    }
-    // "false" as the last argument here means that we do not update the "parent" links
-    // in each member - we just copy the team structure
-    lowestCostTopLevelTeams = new EntityList(children, this, false);
+    // Capacity is retained so the journal doesn't allocate once it has grown to the typical
+    // number of changes between lowest cost solutions
+    changesSinceLowestCost.clear();
+    lowestCostTeamsRecorded = true;
 }
 
 Member* Partition::get_random_member()
 {
-    return (Member*)allMembers[memberdice()];
+    return (Member*)allMembers[randomNumberGenerator.uniform_int(allMembers.size())];
+}
+
+Member* Partition::get_random_member_of(TeamLevel* team)
+{
+    Entity* entity = team;
+    while(!entity->is_member()) {
+	TeamLevel* parent = (TeamLevel*)entity;
+	assert(parent->num_children() > 0);
+	entity = parent->get_children()[randomNumberGenerator.uniform_int(parent->num_children())];
+    }
+    return (Member*)entity;
 }
 
 TeamLevel* Partition::get_random_team()
 {
-    return teamsAtLowestLevel->get_subteam(teamdice());
+    return teamsAtLowestLevel->get_subteam(
+	    randomNumberGenerator.uniform_int(teamsAtLowestLevel->size()));
 }
 
-void Partition::reset_random_team_distribution()
+void Partition::add_team_at_level(TeamLevel* team, int levelNum)
 {
-    teamRandomDistribution.param(uniform_int_distribution<int>::param_type(0, teamsAtLowestLevel->size()-1));
+    team->index = teamsAtEachLevel[levelNum]->size();
+    teamsAtEachLevel[levelNum]->append(team);
+}
+
+TeamLevel* Partition::get_random_team_at_level(int levelNum)
+{
+    assert(levelNum >= 1 && levelNum <= allTeamData->num_levels());
+    return teamsAtEachLevel[levelNum]->get_subteam(
+	    randomNumberGenerator.uniform_int(teamsAtEachLevel[levelNum]->size()));
 }
 
 void Partition::remove_member_from_lowest_level_team(Member* member)
@@ -514,6 +646,7 @@ void Partition::remove_member_from_lowest_level_team(Member* member)
     TeamLevel* team = member->get_parent();
     assert(team);
     team->remove_child(member);
+    changesSinceLowestCost.push_back(TeamChange { member, team });
 }
 
 void Partition::add_member_to_lowest_level_team(Member* member, TeamLevel* team)
@@ -521,16 +654,30 @@ void Partition::add_member_to_lowest_level_team(Member* member, TeamLevel* team)
     team->add_child(member);
 }
 
+void Partition::swap_subteams(TeamLevel* team1, TeamLevel* team2)
+{
+    exchange_subteams(team1, team2);
+    changesSinceLowestCost.push_back(TeamChange { team1, team2 });
+}
+
+void Partition::exchange_subteams(TeamLevel* team1, TeamLevel* team2)
+{
+    assert(&team1->get_level() == &team2->get_level());
+    TeamLevel* parent1 = team1->get_parent();
+    TeamLevel* parent2 = team2->get_parent();
+    assert(parent1 != parent2);
+    int position1 = team1->positionInParent;
+    int position2 = team2->positionInParent;
+    parent1->replace_child_at(position1, team2);
+    parent2->replace_child_at(position2, team1);
+    // Team names depend on position within the parent so they stay with the position
+    swap(team1->name, team2->name);
+}
+
 int Partition::find_index_of(Entity* member)
 {
     int index = children.find_index_of(member);
-#if 0
-    if(index == -1 && lowestCostTopLevelTeams) {
-	// Check in the lowest cost teams
-	index = lowestCostTopLevelTeams->find_index_of(member);
-    }
-#endif
-    assert(index != -1);	// Must be found in one of the lists
+    assert(index != -1);
     return index;
 }
 
@@ -550,6 +697,18 @@ int Partition::num_teams_at_lowest_level() const
     return teamsAtLowestLevel->size();
 }
 
+int Partition::num_teams_at_level(int levelNum) const
+{
+    assert(levelNum >= 1 && levelNum <= allTeamData->num_levels());
+    return teamsAtEachLevel[levelNum]->size();
+}
+
+TeamLevel* Partition::get_team_at_level(int levelNum, int index) const
+{
+    assert(levelNum >= 1 && levelNum <= allTeamData->num_levels());
+    return teamsAtEachLevel[levelNum]->get_subteam(index);
+}
+
 AllTeamData* Partition::get_all_team_data() const
 {
     return allTeamData;
@@ -565,10 +724,7 @@ void Partition::output(ostream& os) const
     for(int i = 1; i <= allTeamData->num_levels(); ++i) {
 	os << "Teams at level " << i << endl << *teamsAtEachLevel[i] << endl;
     }
-    os << "lowestCostTopLevelTeams:" << endl;
-    if(lowestCostTopLevelTeams) {
-	os << *(lowestCostTopLevelTeams);
-    }
+    os << "Team changes since lowest cost: " << changesSinceLowestCost.size() << endl;
     os << "Person to Member Map" << endl;
     map<const Person*,Member*>::const_iterator itr = personToMemberMap.begin();
     while(itr != personToMemberMap.end()) {
@@ -9,12 +9,11 @@
 #include "annealInfo.hh"
 #include "entityList.hh"
 #include "memberIterator.hh"
+#include "random.hh"
 #include <vector>
 #include <map>
 #include <string>
 #include <ostream>
-#include <functional>
-#include <random>
 
 using namespace std;
 
@@ -31,6 +30,9 @@ public:
     string name;
     TeamLevel* parent;	// team that this entity is part of, or null if top level (partition)
     Partition* partition;	// partition that this entity is part of
+    int positionInParent;	// index of this entity in its parent's list of children
+    int index;		// dense index of a member within the partition's members or of a team
+    			// within the partition's teams at the same level (-1 if not yet set)
 
     // Constructor
     Entity(Entity::Type type, Partition* partition);
@@ -52,6 +54,7 @@ public:
     void set_parent(TeamLevel* team);
     TeamLevel* get_parent() const;
     bool has_parent() const;
+    int get_index() const;
 
     bool is_member() const;
     bool is_team() const;
@@ -103,39 +106,36 @@ protected:
 
 public:
     // Constructor
-    // Pseudo-copy constructor - we clone the team, all the way down to, but excluding, 
-    // the lowest level members. If setMemberParents is true we set the parents of the
-    // members to be the new teams
-    TeamLevel(const TeamLevel* team, bool setMemberParents);
     TeamLevel(const Level& level, Partition* partition);
     TeamLevel(const Level& level, const string& name, Partition* partition);
 
     // Other member functions
     void add_child(Entity* child);
+    // Remove the child - the last child takes its position (constant time)
     void remove_child(Entity* child);
+    // Replace the child at the given position with another entity (the replacement's parent 
+    // and position are updated, the old child's are not changed)
+    void replace_child_at(int position, Entity* replacement);
     const Level& get_level() const;
     const EntityList& get_children() const;
     Entity* get_first_child() const;
     int num_children() const;
     int size() const;
     virtual int find_index_of(Entity* child);	// must be found
+    // Lowest common ancestor of this team and another team (which is one of the teams if they're
+    // the same or one is an ancestor of the other, and may be the partition)
+    TeamLevel* common_ancestor(TeamLevel* other);
     void output(ostream& os) const;
     EntityListIterator child_iterator() const;
     MemberIterator member_iterator() const;
 
     void set_full_team_name(const string& name);
     const string& get_full_team_name() const;
-
-    // Copy this team
-    TeamLevel* clone(bool setMemberParents);
-
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 // Partition
 
-// NOTE - can't delete a Partition - the EntityList destructor will result in 
-// some entities being deleted multiple times
 class Partition : public TeamLevel {
 protected:
     // highest level teams are those in the "children" inherited field
@@ -147,18 +147,38 @@ protected:
     					// to this list before being put in teams
     map<const Person*,Member*>	personToMemberMap;
 
-    EntityList*	 	lowestCostTopLevelTeams;
+public:
+    // Change made to the teams. A member entry records the team the member was removed from;
+    // a team entry records the other team in a subteam swap.
+    struct TeamChange {
+	Entity*		entity;
+	TeamLevel*	team;
+    };
+protected:
+    // Changes made to the teams since the current teams were recorded as the lowest cost teams
+    // (in the order they were made). Restoring the lowest cost teams undoes these in reverse 
+    // order so we never need to copy the team hierarchy.
+    vector<TeamChange>	changesSinceLowestCost;
+    bool		lowestCostTeamsRecorded;	// false if teams have been rebuilt since
 
 private:
-    mt19937 randomNumberGenerator;	// Mersenne twister 19937 state generator
-    uniform_int_distribution<int> memberRandomDistribution;
-    uniform_int_distribution<int> teamRandomDistribution;
-    function<int()> memberdice;
-    function<int()> teamdice;
+    const unsigned int partitionNum;	// order in which the partition was created
+    RandomGenerator randomNumberGenerator;
+
+    // Swap the positions (and names) of two teams without recording the change
+    void exchange_subteams(TeamLevel* team1, TeamLevel* team2);
+    // Append a newly created team to the list of teams at its level (setting its index)
+    void add_team_at_level(TeamLevel* team, int levelNum);
 public:
 
-    // Constructor
-    Partition(AllTeamData* allTeamData, const Level& level, const string& name, int numPeople);
+    // Constructor. The random numbers used depend on the partition number and the copy number
+    // (0 for the original partition) so that every partition and copy (e.g. replicas) uses
+    // different random numbers.
+    Partition(AllTeamData* allTeamData, const Level& level, const string& name, int numPeople,
+	    unsigned int partitionNum, unsigned int copyNum = 0);
+
+    // Destructor - deletes all teams and members of this partition
+    ~Partition();
 
     // Other member functions
     Attribute* get_partition_attribute() const;		// nullptr if there is none
@@ -167,21 +187,39 @@ public:
     Member* add_person(const Person* member);
     Member* get_member_for_person(const Person*);
     int num_members() const;
+    unsigned int get_partition_number() const;
 
     void clear();	// clear out memberships in preparation for copying them from elsewhere
     			// e.g. from lowest cost or random or ...
     void populate_random_teams();
     void populate_existing_teams();
+    // Undo all team changes made since set_current_teams_as_lowest_cost() was last called.
+    // (Use CostData::restore_lowest_cost_teams() to keep the costs up to date.)
     void restore_lowest_cost_teams();
-
+    int num_changes_since_lowest_cost() const;
+    const TeamChange& last_change_since_lowest_cost() const;
+    void undo_last_change();
+    // Replace our teams with a copy of the (current) teams in the other partition. The other
+    // partition must be a replica of this one (i.e. have the same people in the same order).
+    void copy_teams_from(Partition* other);
+    // Create a new partition with the same people and a copy of our current teams. (The 
+    // replica does not belong to the AllTeamData and must be deleted by the caller.)
+    Partition* create_replica(unsigned int copyNum);
+
+    // Record the current teams as the lowest cost teams (forgets the journal of changes)
     void set_current_teams_as_lowest_cost();
 
     Member* get_random_member();
+    // Random member of the given team. A random child is chosen at each level below the team
+    // so members of smaller teams are a little more likely to be chosen.
+    Member* get_random_member_of(TeamLevel* team);
     TeamLevel* get_random_team();		// at the lowest level
-    void reset_random_team_distribution();	// must be called after teams are created, 
-    						// before get_random_team()
+    TeamLevel* get_random_team_at_level(int levelNum);
     void remove_member_from_lowest_level_team(Member* member);
     void add_member_to_lowest_level_team(Member* member, TeamLevel* team);
+    // Swap two teams at the same level (with different parents). Each team takes the other's
+    // position (and name) within its parent.
+    void swap_subteams(TeamLevel* team1, TeamLevel* team2);
 
     // Finds the position of the given element in the children of this
     int find_index_of(Entity* member);
@@ -189,6 +227,8 @@ public:
     EntityListIterator teams_at_level_iterator(int levelNum) const;
     EntityListIterator teams_at_lowest_level_iterator() const;
     int num_teams_at_lowest_level() const;
+    int num_teams_at_level(int levelNum) const;
+    TeamLevel* get_team_at_level(int levelNum, int index) const;
     AllTeamData* get_all_team_data() const;
 
     void output(ostream& os) const;
@@ -4,7 +4,9 @@
 
 #include "entityList.hh"
 #include "teamData.hh"
+#include "random.hh"
 #include "assert.h"
+#include <algorithm>
 
 static string emptyString("");
 
@@ -26,29 +28,6 @@ EntityList::EntityList(const EntityList& list) :
 {
 }
 
-// Pseudo copy constructor - teams which are members of this list are cloned and made children
-// of the given parent, members are not cloned and we don't change their parent unless 
-// setMemberParents is true
-EntityList::EntityList(const EntityList& list, TeamLevel* parent, bool setMemberParents)
-{
-    assert(parent);
-    members.reserve(list.size());
-    EntityListIterator itr(list);
-    while(!itr.done()) {
-	if(itr->is_member()) {
-	    append((Member*)itr);
-	    if(setMemberParents) {
-		itr->set_parent(parent);
-	    }
-	} else {
-	    TeamLevel* teamCopy = new TeamLevel((TeamLevel*)itr, setMemberParents);
-	    append(teamCopy);
-	    teamCopy->set_parent(parent);
-	}
-	++itr;
-    }
-}
-
 // Destructor
 EntityList::~EntityList()
 {
@@ -87,6 +66,24 @@ void EntityList::remove(Entity* member)
     throw("Did not find member in list when removing");
 }
 
+Entity* EntityList::remove_at(size_t i)
+{
+    assert(i < members.size());
+    Entity* last = members.back();
+    members.pop_back();
+    if(i == members.size()) {
+	return nullptr;
+    }
+    members[i] = last;
+    return last;
+}
+
+void EntityList::replace_at(size_t i, Entity* replacement)
+{
+    assert(i < members.size());
+    members[i] = replacement;
+}
+
 #if 0
 // Not needed now?
 // Not very efficient
@@ -144,6 +141,11 @@ void EntityList::reserve(size_t size)
     members.reserve(size);
 }
 
+void EntityList::shuffle(RandomGenerator& generator)
+{
+    std::shuffle(members.begin(), members.end(), generator);
+}
+
 EntityListIterator EntityList::list_iterator() const
 {
     return EntityListIterator(*this);
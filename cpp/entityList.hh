@@ -16,6 +16,7 @@ class Member;
 class TeamLevel;
 class Partition;
 class EntityListIterator;
+class RandomGenerator;
 
 ///////////////////////////////////////////////////////////////////////////////
 class EntityList {
@@ -35,18 +36,17 @@ public:
     // Copy constructor - shallow copy
     EntityList(const EntityList& list);
 
-    // Pseudo-copy Constructor - semi-deep copy - we don't copy members, only teams. We
-    // set new parents on copied teams to account for the new structure.
-    // If the elements are at the lowest level (members) we only set their parents if
-    // setMemberParents is true
-    EntityList(const EntityList& list, TeamLevel* parent, bool setMemberParents);
-
     // Member functions
     void clear();			// Does not destroy members - warning - memory may be lost
     // Append member to this entity list 
     void append(Entity* member);
     // Remove member from the entity list. Any iterators on the list are then invalid. Order may change.
     void remove(Entity* member);
+    // Remove the element at the given position by moving the last element into its place.
+    // Returns the element that was moved (nullptr if the last element was removed).
+    Entity* remove_at(size_t i);
+    // Replace the element at the given position with another entity
+    void replace_at(size_t i, Entity* replacement);
     //void append_unique(Entity* member);	// Does not append if already present, inefficient
     Entity* operator[](size_t i) const;
     TeamLevel* get_subteam(size_t i) const;	// members must be teams
@@ -54,6 +54,7 @@ public:
     Entity* find_entity_with_name(const string& name);	// inefficient - searches list
     size_t size() const;
     void reserve(size_t size);
+    void shuffle(RandomGenerator& generator);	// Put the elements in a random order
     EntityListIterator list_iterator() const;
     int find_index_of(Entity* member);	// return -1 if not found, inefficient - searches list
     Entity* first_member() const;
@@ -0,0 +1,69 @@
+//
+// fenwickTree.cpp
+//
+
+#include "fenwickTree.hh"
+#include "assert.h"
+
+// Constructor
+FenwickTree::FenwickTree() :
+	totalValue(0),
+	highestBit(0)
+{
+}
+
+void FenwickTree::reset(int size)
+{
+    values.assign(size, 0);
+    partialSums.assign(size + 1, 0);
+    totalValue = 0;
+    highestBit = 1;
+    while(highestBit * 2 <= size) {
+	highestBit *= 2;
+    }
+}
+
+int FenwickTree::size() const
+{
+    return values.size();
+}
+
+void FenwickTree::set(int index, long long value)
+{
+    assert(value >= 0);
+    long long delta = value - values[index];
+    if(delta == 0) {
+	return;
+    }
+    values[index] = value;
+    totalValue += delta;
+    for(unsigned int i = index + 1; i < partialSums.size(); i += i & -i) {
+	partialSums[i] += delta;
+    }
+}
+
+long long FenwickTree::get(int index) const
+{
+    return values[index];
+}
+
+long long FenwickTree::total() const
+{
+    return totalValue;
+}
+
+int FenwickTree::find(long long amount) const
+{
+    assert(amount >= 0 && amount < totalValue);
+    // Descend the implicit tree - position is the largest (1 based) index whose prefix sum 
+    // doesn't exceed the amount, so the weight at (0 based) index position covers it
+    int position = 0;
+    for(int step = highestBit; step > 0; step /= 2) {
+	int next = position + step;
+	if(next < (int)partialSums.size() && partialSums[next] <= amount) {
+	    position = next;
+	    amount -= partialSums[next];
+	}
+    }
+    return position;
+}
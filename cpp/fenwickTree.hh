@@ -0,0 +1,40 @@
+//
+// fenwickTree.hh
+//
+
+#ifndef FENWICKTREE_HH
+#define FENWICKTREE_HH
+
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// FenwickTree
+//
+// Non-negative integer weights (indexed from 0) which can be updated and sampled from in
+// logarithmic time. Integers are used so that the totals maintained by many updates are exact.
+
+class FenwickTree {
+private:
+    vector<long long> values;
+    vector<long long> partialSums;	// indexed from 1 - entry i is the sum of the values in
+    					// (i - lowbit(i), i] (with values indexed from 1)
+    long long totalValue;
+    int highestBit;			// largest power of two not greater than the size
+public:
+    // Constructor
+    FenwickTree();
+
+    // Set the number of weights - all are set to 0
+    void reset(int size);
+    int size() const;
+    void set(int index, long long value);
+    long long get(int index) const;
+    long long total() const;
+    // Index of the weight which covers the given amount, i.e. the smallest index such that the
+    // sum of the weights up to and including it exceeds the amount. (0 <= amount < total())
+    int find(long long amount) const;
+};
+
+#endif
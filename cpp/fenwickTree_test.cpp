@@ -0,0 +1,115 @@
+//
+// fenwickTree_test.cpp
+//
+// Module for testing FenwickTree - find() is checked against a linear scan of the prefix sums
+// after random updates
+
+#include <iostream>
+#include <vector>
+#include "fenwickTree.hh"
+#include "random.hh"
+using namespace std;
+
+static int numFailures = 0;
+
+static void check(bool ok, const char* what, int size, long long amount)
+{
+    if(!ok) {
+	cerr << "FAILED: " << what << " (size " << size << ", amount " << amount << ")" << endl;
+	++numFailures;
+    }
+}
+
+// Smallest index such that the sum of the weights up to and including it exceeds the amount
+static int linear_find(const vector<long long>& weights, long long amount)
+{
+    long long sum = 0;
+    for(unsigned int i = 0; i < weights.size(); ++i) {
+	sum += weights[i];
+	if(sum > amount) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+static void check_tree(const FenwickTree& tree, const vector<long long>& weights)
+{
+    int size = weights.size();
+    check(tree.size() == size, "size", size, 0);
+    long long total = 0;
+    for(int i = 0; i < size; ++i) {
+	check(tree.get(i) == weights[i], "get", size, i);
+	total += weights[i];
+    }
+    check(tree.total() == total, "total", size, 0);
+    if(total == 0) {
+	return;
+    }
+    // Amounts either side of each boundary between weights, then the last amount
+    long long sum = 0;
+    for(int i = 0; i < size; ++i) {
+	sum += weights[i];
+	if(sum > 0 && sum < total) {
+	    check(tree.find(sum - 1) == linear_find(weights, sum - 1), "find", size, sum - 1);
+	    check(tree.find(sum) == linear_find(weights, sum), "find", size, sum);
+	}
+    }
+    check(tree.find(0) == linear_find(weights, 0), "find", size, 0);
+    check(tree.find(total - 1) == linear_find(weights, total - 1), "find", size, total - 1);
+}
+
+// Set random weights (many of them 0) then update random entries, checking the tree as we go
+static void test_size(FenwickTree& tree, int size, RandomGenerator& random)
+{
+    tree.reset(size);
+    vector<long long> weights(size, 0);
+    check_tree(tree, weights);
+    for(int i = 0; i < size; ++i) {
+	weights[i] = (random.uniform_int(5) < 2) ? 0 : random.uniform_int(1000);
+	tree.set(i, weights[i]);
+    }
+    check_tree(tree, weights);
+    for(int update = 0; update < 200; ++update) {
+	int i = random.uniform_int(size);
+	// Large weights as well as small ones - totals can exceed the range of an int
+	weights[i] = (random.uniform_int(3) == 0) ? 0 :
+		(long long)random.uniform_int(1 << 30) * (1 + random.uniform_int(16));
+	tree.set(i, weights[i]);
+	if(update % 20 == 0) {
+	    check_tree(tree, weights);
+	}
+    }
+    check_tree(tree, weights);
+
+    // A single non-zero weight must be found for every amount
+    weights.assign(size, 0);
+    tree.reset(size);
+    int index = random.uniform_int(size);
+    weights[index] = 3;
+    tree.set(index, 3);
+    check_tree(tree, weights);
+}
+
+int main(int argc, char* argv[])
+{
+    set_master_random_seed(1);
+    RandomGenerator random(RandomGenerator::PARTITION, 0, 0);
+    // Every size up to a few powers of two then sizes around larger powers of two - the same
+    // tree is reset to each size
+    FenwickTree tree;
+    for(int size = 1; size <= 70; ++size) {
+	test_size(tree, size, random);
+    }
+    const int largerSizes[] = { 127, 128, 129, 1000, 1023, 1024, 1025 };
+    for(int size : largerSizes) {
+	test_size(tree, size, random);
+    }
+
+    if(numFailures > 0) {
+	cerr << numFailures << " checks failed" << endl;
+	return 1;
+    }
+    cout << "All FenwickTree checks passed" << endl;
+    return 0;
+}
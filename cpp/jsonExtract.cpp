@@ -13,6 +13,7 @@ static const string PARTITION_STRING = "partition";
 static const string LEVELS_STRING = "levels";
 static const string NAME_FORMAT_STRING = "name-format";
 static const string CONSTRAINTS_STRING = "constraints";
+static const string COOLING_STRING = "cooling";
 
 static const double MUST_HAVE_WEIGHT = 1000.0;
 static const double SHOULD_HAVE_WEIGHT = 50.0;
@@ -24,6 +25,7 @@ static void json_parse_teamanneal_v1(AnnealInfo&, JSONObject*);
 static void json_parse_levels_v1(AnnealInfo&, Attribute* partition, JSONArray*);
 static void json_parse_name_format_v1(AnnealInfo&, JSONObject*);
 static void json_parse_constraints_v1(AnnealInfo&, JSONArray*);
+static void json_parse_cooling_v1(AnnealInfo&, JSONObject*);
 
 const string& get_identifier_from_json_object(JSONValue* val)
 {
@@ -98,6 +100,12 @@ void json_parse_teamanneal_v1(AnnealInfo& annealInfo, JSONObject* obj)
 	throw ConstraintException("Did not find array attribute ", CONSTRAINTS_STRING);
     }
 
+    // Cooling settings are optional
+    if(obj->has_attribute(COOLING_STRING)) {
+	JSONObject* coolingJSONObject = (JSONObject*)obj->find(COOLING_STRING, JSON_OBJECT);
+	json_parse_cooling_v1(annealInfo, coolingJSONObject);
+    }
+
     // Iterate over all the fields of the object to make sure we don't have any invalid fields
     for(JSONObject::Iterator it = obj->iterator(); it != obj->end(); ++it) {
 	if(it->first != VERSION_STRING &&
@@ -105,7 +113,8 @@ void json_parse_teamanneal_v1(AnnealInfo& annealInfo, JSONObject* obj)
 		it->first != PARTITION_STRING &&
 		it->first != LEVELS_STRING &&
 		it->first != NAME_FORMAT_STRING &&
-		it->first != CONSTRAINTS_STRING) {
+		it->first != CONSTRAINTS_STRING &&
+		it->first != COOLING_STRING) {
 	    // Anything else is an invalid field
 	    throw ConstraintException("Unexpected attribute ", it->first);
 	}
@@ -190,6 +199,7 @@ static void json_parse_levels_v1(AnnealInfo& annealInfo, Attribute* partitionAtt
 			 (int)idealNumber->get_value(), 
 			 (int)maxNumber->get_value());
 	annealInfo.add_level(level);
+	parentLevel->add_child_level(level);
 	++levelNum;
 	// This level will be the parent for the next level (if any)
 	parentLevel = level;
@@ -339,6 +349,32 @@ static void json_parse_constraints_v1(AnnealInfo& annealInfo, JSONArray* constra
     }
 }
 
+static void json_parse_cooling_v1(AnnealInfo& annealInfo, JSONObject* coolingObject)
+{
+    // There MAY be attributes "schedule" and "reheats"
+    CoolingOptions options;
+    if(coolingObject->has_attribute("schedule")) {
+	const string& scheduleString = coolingObject->find_string("schedule");
+	if(!options.set_schedule(scheduleString)) {
+	    throw ConstraintException("Cooling schedule must be one of 'default','geometric',"
+		    "'lundy-mees','lam' not ", scheduleString);
+	}
+    }
+    if(coolingObject->has_attribute("reheats")) {
+	double reheats = coolingObject->find_number("reheats");
+	if(reheats < 0 || reheats != (int)reheats) {
+	    throw ConstraintException("Number of reheats must be a non-negative integer ", reheats);
+	}
+	options.maxReheats = (int)reheats;
+    }
+    for(JSONObject::Iterator it = coolingObject->iterator(); it != coolingObject->end(); ++it) {
+	if(it->first != "schedule" && it->first != "reheats") {
+	    throw ConstraintException("Unexpected cooling attribute ", it->first);
+	}
+    }
+    annealInfo.set_cooling_options(options);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // ConstraintException
 ///////////////////////////////////////////////////////////////////////////////
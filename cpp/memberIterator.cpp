@@ -8,61 +8,60 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // MemberIterator
-void MemberIterator::find_next(bool advance)
+void MemberIterator::find_next()
 {
-    if(listStack.size() == 0) {
-	return;		// End of the road - we've traversed everything
-    }
-    EntityListIterator& top = listStack.top();
-    if(top.done()) {
-	// We're done at this level - go up one and keep trying
-	listStack.pop();
-	find_next(true);
-    } else if(advance) {
-	++top;
-	find_next(false);
-    } else if(top->is_member()) {
-	// We've found a member - stop here
-    } else {
-	assert(top->is_team());
-	// We're at a team level - go lower
-	listStack.emplace(((TeamLevel*)top)->get_children());
-	// Find next member if we're not at one
-	find_next(false);
+    while(depth >= 0) {
+	if(positions[depth] >= lists[depth]->size()) {
+	    // We're done at this level - go up one and move on
+	    --depth;
+	    if(depth >= 0) {
+		++positions[depth];
+	    }
+	} else {
+	    Entity* entity = (*lists[depth])[positions[depth]];
+	    if(entity->is_member()) {
+		// We've found a member - stop here
+		return;
+	    }
+	    assert(entity->is_team() && depth < MAX_LEVELS);
+	    // We're at a team level - go lower
+	    ++depth;
+	    lists[depth] = &((TeamLevel*)entity)->get_children();
+	    positions[depth] = 0;
+	}
     }
 }
 
 // Constructor
-MemberIterator::MemberIterator(const TeamLevel* team)
+MemberIterator::MemberIterator(const TeamLevel* team) :
+	depth(0)
 {
     // Work our way down to the lowest level
-    listStack.emplace(team->get_children());
-    find_next(false);
+    lists[0] = &team->get_children();
+    positions[0] = 0;
+    find_next();
 }
 
 Member& MemberIterator::operator*() const
 {
-    const EntityListIterator& top = listStack.top();
-    return *(Member*)top;
+    return *(Member*)(*lists[depth])[positions[depth]];
 }
 
 Member* MemberIterator::operator->() const
 {
-    const EntityListIterator& top = listStack.top();
-    return (Member*)top;
+    return (Member*)(*lists[depth])[positions[depth]];
 }
 
 MemberIterator::operator Member*() const
 {
-    const EntityListIterator& top = listStack.top();
-    return (Member*)top;
+    return (Member*)(*lists[depth])[positions[depth]];
 }
 
 MemberIterator& MemberIterator::operator++()	// prefix
 {
-    // Get top of stack - if it points to something
-    assert(!listStack.top().done());
-    find_next(true);
+    assert(!done());
+    ++positions[depth];
+    find_next();
     return *this;
 }
 
@@ -75,11 +74,5 @@ MemberIterator MemberIterator::operator++(int)	// postfix
 
 bool MemberIterator::done() const
 {
-    if(listStack.size() == 0) {
-	return true;
-    } else {
-	const EntityListIterator& top = listStack.top();
-	return top.done();
-    }
+    return depth < 0;
 }
-
@@ -7,7 +7,7 @@
 
 #include "person.hh"
 #include "entityList.hh"
-#include <stack>
+#include "level.hh"
 
 using namespace std;
 
@@ -16,9 +16,12 @@ class Member;
 ///////////////////////////////////////////////////////////////////////////////
 class MemberIterator {
 private:
-    stack<EntityListIterator> listStack;
-    void find_next(bool advance);		// find the current member - if advance is true
-  						// then we move on to the next member.
+    // The lists we're traversing - from the children of the starting team (depth 0) down to 
+    // the list the current member is in. Fixed size so that iterating doesn't allocate.
+    const EntityList* lists[MAX_LEVELS + 1];
+    unsigned int positions[MAX_LEVELS + 1];
+    int depth;			// -1 when we've traversed everything
+    void find_next();		// find the first member at or after the current position
 public:
     MemberIterator(const TeamLevel* team);
     Member& operator*() const;
@@ -3,7 +3,6 @@
 //
 
 #include "moveSet.hh"
-#include <ctime>
 #include <cmath>
 #include "assert.h"
 #include <algorithm>
@@ -11,7 +10,82 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // static member definition
-array<double,2> MoveSet::moveProbabilities = {{0.9, 0.1}};
+array<double,MoveSet::NUM_MOVE_TYPES> MoveSet::moveProbabilities = {{0.7, 0.1, 0.1, 0.05, 0.05}};
+const char* MoveSet::moveTypeNames[MoveSet::NUM_MOVE_TYPES] = 
+	{"swap-members", "move-member", "swap-subteams", "rotate-members", "ejection-chain"};
+
+// Adaptive pursuit parameters. Every applicable move type keeps at least the minimum probability
+// so that we notice when it becomes productive again.
+static const double MIN_MOVE_PROBABILITY = 0.05;
+static const double MOVE_QUALITY_LEARNING_RATE = 0.3;	// rate quality estimates follow rewards
+static const double MOVE_PROBABILITY_ADAPTATION_RATE = 0.3;	// rate probabilities follow quality
+// Proportion of swap scope choices made uniformly rather than based on costs
+static const double SWAP_SCOPE_UNIFORM_PROPORTION = 0.2;
+// The anneal is frozen (few uphill moves are being accepted) when the proportion of uphill
+// moves accepted over recent steps falls below this
+static const double FROZEN_UPHILL_PROBABILITY = 0.0025;
+// The anneal is reheated (if allowed) when it has gone this many steps without improving
+// on the lowest cost, or is frozen, and the temperature has fallen below the given ratio of
+// the reheat temperature. The reheat temperature is the last temperature at which at least
+// the given proportion of uphill moves were accepted.
+static const int REHEAT_STAGNANT_STEPS = 50;
+static const double REHEAT_MIN_TEMPERATURE_RATIO = 0.25;
+static const double REHEAT_UPHILL_PROBABILITY = 0.3;
+
+// Number of moves between checks of the anneal's budget
+static const int BUDGET_CHECK_INTERVAL = 64;
+
+// Proportion of cost guided team choices made uniformly (so that every team can be chosen)
+static const double COST_GUIDED_UNIFORM_PROPORTION = 0.2;
+
+///////////////////////////////////////////////////////////////////////////////
+// MoveTypeStats
+
+// Constructor
+MoveTypeStats::MoveTypeStats()
+{
+    reset();
+}
+
+void MoveTypeStats::reset()
+{
+    numAttempts = 0;
+    numAccepted = 0;
+    sumImprovement = 0.0;
+    sumSeconds = 0.0;
+    sumWork = 0;
+}
+
+void MoveTypeStats::log_move(double deltaCost, bool accepted, long long work)
+{
+    ++numAttempts;
+    sumWork += work;
+    if(accepted) {
+	++numAccepted;
+	if(deltaCost < 0) {
+	    sumImprovement -= deltaCost;
+	}
+    }
+}
+
+void MoveTypeStats::add(const MoveTypeStats& other)
+{
+    numAttempts += other.numAttempts;
+    numAccepted += other.numAccepted;
+    sumImprovement += other.sumImprovement;
+    sumSeconds += other.sumSeconds;
+    sumWork += other.sumWork;
+}
+
+double MoveTypeStats::acceptance_rate() const
+{
+    return (numAttempts > 0) ? (double)numAccepted / numAttempts : 0.0;
+}
+
+double MoveTypeStats::improvement_per_unit_of_work() const
+{
+    return (sumWork > 0) ? sumImprovement / sumWork : 0.0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // AnnealMove
@@ -21,15 +95,70 @@ AnnealMove::AnnealMove(MoveSet* moveSet, Partition* partition, CostData* costDat
 	moveSet(moveSet),
 	partition(partition),
 	costData(costData),
-	lastMoveAccepted(false)
+	lastMoveAccepted(false),
+	acceptanceThreshold(0.0)
 {
 }
 
+// Destructor
+AnnealMove::~AnnealMove()
+{
+}
+
+bool AnnealMove::is_applicable() const
+{
+    return true;
+}
+
 bool AnnealMove::accepted()
 {
     return lastMoveAccepted;
 }
 
+void AnnealMove::set_acceptance_threshold(double temperature)
+{
+    if(temperature > 0) {
+	// Accepting an uphill move with probability exp(-deltaCost/T) is the same as accepting
+	// it if deltaCost <= -T ln(u) for u uniform in [0,1). Downhill moves are always accepted.
+	acceptanceThreshold = - temperature * log(moveSet->random0to1());
+    } else {
+	acceptanceThreshold = INFINITY;		// all moves accepted
+    }
+}
+
+bool AnnealMove::reject_early(double deltaCostLowerBound)
+{
+    if(deltaCostLowerBound > acceptanceThreshold) {
+	reject_move(deltaCostLowerBound);
+	return true;
+    }
+    return false;
+}
+
+void AnnealMove::reject_move(double deltaCost)
+{
+    lastMoveAccepted = false;
+    moveSet->log_cost(deltaCost, lastMoveAccepted);
+    costData->undo_pending();
+#ifdef DEBUG
+    cout << "no" << endl;
+#endif
+}
+
+bool AnnealMove::accept_move(double deltaCost)
+{
+    if(deltaCost > acceptanceThreshold) {
+	reject_move(deltaCost);
+	return false;
+    }
+#ifdef DEBUG
+    cout << "yes (" << deltaCost << ")" << endl;
+#endif
+    lastMoveAccepted = true;
+    moveSet->log_cost(deltaCost, lastMoveAccepted);
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // MoveMember
 
@@ -39,12 +168,60 @@ MoveMember::MoveMember(MoveSet* moveSet, Partition* partition, CostData* costDat
 {
 }
 
+// Find a random member and a random team to move them to such that the team sizes of both the
+// member's team and the destination team stay within the limits for the level. Returns false
+// if no such move was found.
+bool MoveMember::find_random_move(Member*& member, TeamLevel*& toTeam)
+{
+    for(int attempt = 0; attempt < MAX_ATTEMPTS_TO_FIND_MOVE; ++attempt) {
+	member = partition->get_random_member();
+	TeamLevel* fromTeam = member->get_parent();
+	const Level& level = fromTeam->get_level();
+	if(fromTeam->size() <= max(level.get_min_size(), 1)) {
+	    continue;	// team would become too small
+	}
+	toTeam = partition->get_random_team();
+	if(toTeam != fromTeam && toTeam->size() < level.get_max_size()) {
+	    return true;
+	}
+    }
+    return false;
+}
+
 double MoveMember::generate_and_evaluate_random_move(double temperature)
 {
+    Member* member;
+    TeamLevel* toTeam;
+    if(!find_random_move(member, toTeam)) {
+	// Teams are at their size limits - nothing to do. (The attempt is still logged against 
+	// this move type so that its probability falls if this keeps happening.)
+	lastMoveAccepted = false;
+	return 0.0;
+    }
 #ifdef DEBUG
-    cout << "Move Member - doing nothing " << endl;
+    cout << "Moving " << member->get_id() << " to " << toTeam->get_full_team_name() << ": ";
 #endif
-    return 0.0;
+    set_acceptance_threshold(temperature);
+    // Costs at and above the common ancestor of the two teams don't change
+    TeamLevel* commonAncestor = member->get_parent()->common_ancestor(toTeam);
+    double deltaCost = costData->pend_remove_member(member, commonAncestor);
+    // Adding the member to the new team is the only change left
+    if(reject_early(deltaCost + 
+	    costData->min_delta_for_member_changes(&toTeam, 1, 1, commonAncestor))) {
+	return deltaCost;
+    }
+    deltaCost += costData->pend_add_member(member, toTeam, commonAncestor);
+
+    if(!accept_move(deltaCost)) {
+	return deltaCost;
+    }
+    // Update team memberships
+    partition->remove_member_from_lowest_level_team(member);
+    partition->add_member_to_lowest_level_team(member, toTeam);
+    // Update costs
+    costData->commit_pending();
+    moveSet->check_for_lowest_cost();
+    return deltaCost;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -57,13 +234,62 @@ SwapMembers::SwapMembers(MoveSet* moveSet, Partition* partition, CostData* costD
     assert(partition->num_teams_at_lowest_level() > 1);	// Number of subteams must be more than one
 }
 
+// Choose random members in different teams with different signatures. The second member is 
+// chosen from within the first member's ancestor at a random swap scope level (or from the 
+// whole partition if no suitable member is found there). Returns false if no such pair was 
+// found.
+bool SwapMembers::find_random_move(Member*& member1, Member*& member2)
+{
+    if(moveSet->cost_guided_swaps()) {
+	member1 = partition->get_random_member_of(moveSet->get_cost_guided_random_team());
+    } else {
+	member1 = partition->get_random_member();
+    }
+    int scopeLevel = moveSet->get_random_swap_scope();
+    TeamLevel* scopeTeam = member1->get_parent();
+    while(scopeTeam->get_level().get_level_num() > scopeLevel) {
+	scopeTeam = scopeTeam->get_parent();
+    }
+    while(true) {
+	for(int attempt = 0; attempt < MAX_ATTEMPTS_TO_FIND_MOVE; ++attempt) {
+	    if(scopeTeam->is_partition()) {
+		member2 = partition->get_random_member();
+	    } else {
+		member2 = partition->get_random_member_of(scopeTeam);
+	    }
+	    if(member1->get_parent() != member2->get_parent() && 
+		    costData->get_signature(member1) != costData->get_signature(member2)) {
+		return true;
+	    }
+	}
+	if(scopeTeam->is_partition()) {
+	    return false;
+	}
+	scopeTeam = partition;
+    }
+}
+
+// Pend the swap of the given members and return the delta cost
+double SwapMembers::pend_swap(Member* member1, Member* member2)
+{
+    TeamLevel* team1 = member1->get_parent();
+    TeamLevel* team2 = member2->get_parent();
+    TeamLevel* commonAncestor = team1->common_ancestor(team2);
+    double deltaCost = costData->pend_remove_member(member1, commonAncestor);
+    deltaCost += costData->pend_add_member(member2, team1, commonAncestor);
+    deltaCost += costData->pend_remove_member(member2, commonAncestor);
+    deltaCost += costData->pend_add_member(member1, team2, commonAncestor);
+    return deltaCost;
+}
+
 double SwapMembers::generate_and_evaluate_random_move(double temperature)
 {
     Member *member1, *member2;
-    member1 = partition->get_random_member();
-    do {
-	member2 = partition->get_random_member();
-    } while (member1->get_parent() == member2->get_parent());
+    if(!find_random_move(member1, member2)) {
+	// All the members we tried are interchangeable with the first - nothing to do
+	lastMoveAccepted = false;
+	return 0.0;
+    }
 #ifdef DEBUG
     cout << "Swapping " << member1->get_id() << " and " << member2->get_id() << ": ";
 #endif
@@ -71,37 +297,229 @@ double SwapMembers::generate_and_evaluate_random_move(double temperature)
     TeamLevel* team1 = member1->get_parent();
     TeamLevel* team2 = member2->get_parent();
 
-    double deltaCost = costData->pend_remove_member(member1);
-    deltaCost += costData->pend_remove_member(member2);
-    deltaCost += costData->pend_add_member(member1, team2);
-    deltaCost += costData->pend_add_member(member2, team1);
+    set_acceptance_threshold(temperature);
+    // The acceptance of cost guided swaps depends on the team weights after the swap so the
+    // whole swap must be pended - the move can't be rejected early or its delta cost looked up
+    bool guided = moveSet->cost_guided_swaps() && temperature > 0;
+    double deltaCost;
+    bool deltaKnown = !guided && costData->find_swap_delta(member1, member2, deltaCost);
+    if(!deltaKnown) {
+	// Evaluate the changes to the first team (and its ancestors below the common ancestor of 
+	// the two teams - costs at and above it don't change) then check whether the move can 
+	// already be rejected - the second team has two changes left
+	TeamLevel* commonAncestor = team1->common_ancestor(team2);
+	deltaCost = costData->pend_remove_member(member1, commonAncestor);
+	deltaCost += costData->pend_add_member(member2, team1, commonAncestor);
+	if(!guided && reject_early(deltaCost + 
+		costData->min_delta_for_member_changes(&team2, 1, 2, commonAncestor))) {
+	    return deltaCost;
+	}
+	deltaCost += costData->pend_remove_member(member2, commonAncestor);
+	deltaCost += costData->pend_add_member(member1, team2, commonAncestor);
+	costData->save_swap_delta(member1, member2, deltaCost);
+    }
+    if(guided) {
+	// Approximate Hastings correction - the acceptance probability is multiplied by the ratio
+	// of the reverse and forward proposal probabilities. The swap is proposed if either member
+	// is chosen first (from its team, with the team weights before the swap for the forward
+	// swap and after it for the reverse swap) and the other is then chosen from the swap 
+	// scope. Team sizes and ancestors don't change so the probability of choosing the second
+	// member is taken to be the same in both directions and cancels. (It isn't quite - members
+	// which can't be swapped with the first are redrawn and the number of these may differ.)
+	double forward = moveSet->cost_guided_team_probability(team1) / team1->size() +
+		moveSet->cost_guided_team_probability(team2) / team2->size();
+	double reverse = moveSet->pending_cost_guided_team_probability(team1) / team1->size() +
+		moveSet->pending_cost_guided_team_probability(team2) / team2->size();
+	acceptanceThreshold += temperature * log(reverse / forward);
+    }
+
+    if(!accept_move(deltaCost)) {
+	return deltaCost;
+    }
+    if(deltaKnown) {
+	// The changes haven't been pended yet
+	deltaCost = pend_swap(member1, member2);
+    }
+    // Update team memberships
+    partition->remove_member_from_lowest_level_team(member1);
+    partition->remove_member_from_lowest_level_team(member2);
+    partition->add_member_to_lowest_level_team(member1, team2);
+    partition->add_member_to_lowest_level_team(member2, team1);
+    // Update costs
+    costData->commit_pending();
+    moveSet->check_for_lowest_cost();
+    return deltaCost;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SwapSubteams
+
+// Constructor
+SwapSubteams::SwapSubteams(MoveSet* moveSet, Partition* partition, CostData* costData) :
+	AnnealMove(moveSet, partition, costData)
+{
+    // Teams at level 1 all have the partition as their parent so can't be swapped. At lower 
+    // levels, we need more than one parent team.
+    int numLevels = partition->get_all_team_data()->num_levels();
+    for(int levelNum = 2; levelNum <= numLevels; ++levelNum) {
+	if(partition->num_teams_at_level(levelNum - 1) > 1) {
+	    swappableLevels.push_back(levelNum);
+	}
+    }
+}
 
+bool SwapSubteams::is_applicable() const
+{
+    return !swappableLevels.empty();
+}
 
-    if(deltaCost > 0 && temperature > 0) {
-	// Move makes things worse - accept with probability related to temperature
-	double acceptProbability = exp(- deltaCost / temperature);
-	if(moveSet->random0to1Dice() > acceptProbability) {
-	    // Don't accept the move
-	    lastMoveAccepted = false;
-	    moveSet->log_cost(deltaCost, lastMoveAccepted);
-	    costData->undo_pending();
+double SwapSubteams::generate_and_evaluate_random_move(double temperature)
+{
+    assert(is_applicable());
+    int levelNum = swappableLevels[(int)(moveSet->random0to1() * swappableLevels.size())
+	    % swappableLevels.size()];
+    TeamLevel* team1 = partition->get_random_team_at_level(levelNum);
+    TeamLevel* team2;
+    do {
+	team2 = partition->get_random_team_at_level(levelNum);
+    } while(team1->get_parent() == team2->get_parent());
+    TeamLevel* parent1 = team1->get_parent();
+    TeamLevel* parent2 = team2->get_parent();
 #ifdef DEBUG
-	    cout << "no" << endl;
+    cout << "Swapping subteams " << team1->get_name() << " and " << team2->get_name() << ": ";
 #endif
-	    return deltaCost;
+
+    set_acceptance_threshold(temperature);
+    double deltaCost = costData->pend_move_subteam(team1, parent2);
+    deltaCost += costData->pend_move_subteam(team2, parent1);
+
+    if(!accept_move(deltaCost)) {
+	return deltaCost;
+    }
+    // Update team memberships
+    partition->swap_subteams(team1, team2);
+    // Update costs
+    costData->commit_pending();
+    moveSet->check_for_lowest_cost();
+    return deltaCost;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RotateMembers
+
+// Definitions of the chain length limits (needed when they're bound to references, e.g. by min())
+const int RotateMembers::MIN_CHAIN_TEAMS;
+const int RotateMembers::MAX_CHAIN_TEAMS;
+
+// Constructor
+RotateMembers::RotateMembers(MoveSet* moveSet, Partition* partition, CostData* costData, 
+		bool ejectionChain) :
+	AnnealMove(moveSet, partition, costData),
+	ejectionChain(ejectionChain)
+{
+    chainMembers.reserve(MAX_CHAIN_TEAMS);
+    chainTeams.reserve(MAX_CHAIN_TEAMS);
+}
+
+bool RotateMembers::is_applicable() const
+{
+    return (partition->num_teams_at_lowest_level() >= MIN_CHAIN_TEAMS);
+}
+
+bool RotateMembers::team_in_chain(const TeamLevel* team) const
+{
+    return (find(chainTeams.begin(), chainTeams.end(), team) != chainTeams.end());
+}
+
+// Choose random members from the given number of distinct teams (for an ejection chain, the
+// last team is chosen directly and must have room for another member). Returns false if no 
+// suitable chain was found.
+bool RotateMembers::find_random_chain(int numTeams)
+{
+    chainMembers.clear();
+    chainTeams.clear();
+    int numMembers = ejectionChain ? numTeams - 1 : numTeams;
+    for(int i = 0; i < numMembers; ++i) {
+	int attempt = 0;
+	Member* member;
+	do {
+	    if(++attempt > MAX_ATTEMPTS_TO_FIND_MOVE) {
+		return false;
+	    }
+	    member = partition->get_random_member();
+	} while(team_in_chain(member->get_parent()));
+	chainMembers.push_back(member);
+	chainTeams.push_back(member->get_parent());
+    }
+    if(ejectionChain) {
+	// The first team loses a member, the last team gains one
+	const Level& level = chainTeams[0]->get_level();
+	if(chainTeams[0]->size() <= max(level.get_min_size(), 1)) {
+	    return false;
+	}
+	for(int attempt = 0; attempt < MAX_ATTEMPTS_TO_FIND_MOVE; ++attempt) {
+	    TeamLevel* team = partition->get_random_team();
+	    if(!team_in_chain(team) && team->size() < level.get_max_size()) {
+		chainTeams.push_back(team);
+		return true;
+	    }
 	}
+	return false;
+    }
+    return true;
+}
+
+double RotateMembers::generate_and_evaluate_random_move(double temperature)
+{
+    assert(is_applicable());
+    int maxTeams = min(MAX_CHAIN_TEAMS, partition->num_teams_at_lowest_level());
+    int numTeams = MIN_CHAIN_TEAMS + 
+	    (int)(moveSet->random0to1() * (maxTeams - MIN_CHAIN_TEAMS + 1)) % 
+	    (maxTeams - MIN_CHAIN_TEAMS + 1);
+    if(!find_random_chain(numTeams)) {
+	// Can't find a chain - nothing to do (as for MoveMember)
+	lastMoveAccepted = false;
+	return 0.0;
     }
 #ifdef DEBUG
-    cout << "yes (" << deltaCost << ")" << endl;
+    cout << (ejectionChain ? "Ejection chain of " : "Rotating ") << chainMembers.size() 
+	    << " members: ";
 #endif
-    // If we get here, we accept the move
-    lastMoveAccepted = true;
-    moveSet->log_cost(deltaCost, lastMoveAccepted);
+    // Each member moves to the next team in the chain (wrapping around for a cycle). Costs at
+    // and above the common ancestor of all the teams in the chain don't change.
+    set_acceptance_threshold(temperature);
+    TeamLevel* commonAncestor = chainTeams[0];
+    for(unsigned int i = 1; i < chainTeams.size(); ++i) {
+	commonAncestor = commonAncestor->common_ancestor(chainTeams[i]);
+    }
+    double deltaCost = 0.0;
+    for(unsigned int i = 0; i < chainMembers.size(); ++i) {
+	deltaCost += costData->pend_remove_member(chainMembers[i], commonAncestor);
+    }
+    // Only additions remain - check whether the move can already be rejected. (Every team in
+    // the chain receives a member except the first team of an ejection chain.)
+    int firstTeamAddedTo = ejectionChain ? 1 : 0;
+    if(reject_early(deltaCost + costData->min_delta_for_member_changes(
+	    chainTeams.data() + firstTeamAddedTo, chainTeams.size() - firstTeamAddedTo, 1,
+	    commonAncestor))) {
+	return deltaCost;
+    }
+    for(unsigned int i = 0; i < chainMembers.size(); ++i) {
+	deltaCost += costData->pend_add_member(chainMembers[i], 
+		chainTeams[(i + 1) % chainTeams.size()], commonAncestor);
+    }
+
+    if(!accept_move(deltaCost)) {
+	return deltaCost;
+    }
     // Update team memberships
-    partition->remove_member_from_lowest_level_team(member1);
-    partition->remove_member_from_lowest_level_team(member2);
-    partition->add_member_to_lowest_level_team(member1, team2);
-    partition->add_member_to_lowest_level_team(member2, team1);
+    for(unsigned int i = 0; i < chainMembers.size(); ++i) {
+	partition->remove_member_from_lowest_level_team(chainMembers[i]);
+    }
+    for(unsigned int i = 0; i < chainMembers.size(); ++i) {
+	partition->add_member_to_lowest_level_team(chainMembers[i], 
+		chainTeams[(i + 1) % chainTeams.size()]);
+    }
     // Update costs
     costData->commit_pending();
     moveSet->check_for_lowest_cost();
@@ -112,29 +530,214 @@ double SwapMembers::generate_and_evaluate_random_move(double temperature)
 // MoveSet
 
 // Constructor
-MoveSet::MoveSet(Partition* partition, CostData* costData) :
+MoveSet::MoveSet(Partition* partition, CostData* costData, unsigned int copyNum) :
 	partition(partition),
 	costData(costData),
 	temperature(0.0),
+	finalTemperature(0.0),
+	numMovesMade(0),
 	lowestCost(costData->get_cost_value()),
-#ifdef CONSTANT_RANDOM_SEED
-	randomNumberGenerator(0),
-#else
-	randomNumberGenerator(time(nullptr)), 	// Seed RN generator with current time
-#endif
-	moveDistribution(moveProbabilities.begin(), moveProbabilities.end()),
-	uniform0to1Distribution(0.0, 1.0),
-	moveDice(bind(moveDistribution, randomNumberGenerator)),
-	random0to1Dice(bind(uniform0to1Distribution, randomNumberGenerator))
+	randomNumberGenerator(RandomGenerator::MOVE_SET, partition->get_partition_number(), copyNum),
+	costGuidedSwaps(false)
+{
+    moves[SWAP] = new SwapMembers(this, partition, costData);
+    moves[MOVE] = new MoveMember(this, partition, costData);
+    moves[SWAP_SUBTEAMS] = new SwapSubteams(this, partition, costData);
+    moves[ROTATE] = new RotateMembers(this, partition, costData, false);
+    moves[EJECTION_CHAIN] = new RotateMembers(this, partition, costData, true);
+
+    // Don't use moves which aren't possible for this partition's team structure
+    double sumProbabilities = 0.0;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	moveApplicable[i] = moves[i]->is_applicable();
+	currentMoveProbabilities[i] = moveApplicable[i] ? moveProbabilities[i] : 0.0;
+	sumProbabilities += currentMoveProbabilities[i];
+	moveQuality[i] = 0.0;
+    }
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	currentMoveProbabilities[i] /= sumProbabilities;
+    }
+    moveDistribution = discrete_distribution<int>(currentMoveProbabilities.begin(), 
+	    currentMoveProbabilities.end());
+    adapt_swap_scopes();
+}
+
+// Destructor
+MoveSet::~MoveSet()
+{
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	delete moves[i];
+    }
+}
+
+MoveSet::Type MoveSet::get_random_move_type()
+{
+    // We use the distribution directly (rather than binding it) so that the probabilities
+    // can be adapted as we go
+    return (MoveSet::Type)moveDistribution(randomNumberGenerator);
+}
+
+double MoveSet::random0to1()
+{
+    return randomNumberGenerator.uniform0to1();
+}
+
+double MoveSet::make_random_move(bool& accepted)
+{
+    MoveSet::Type type = get_random_move_type();
+    AnnealMove* move = moves[type];
+    unsigned long long startEvaluations = costData->get_num_cost_evaluations();
+    double deltaCost = move->generate_and_evaluate_random_move(temperature);
+    accepted = move->accepted();
+    ++numMovesMade;
+    stepMoveStats[type].log_move(deltaCost, accepted, 
+	    1 + costData->get_num_cost_evaluations() - startEvaluations);
+    return deltaCost;
+}
+
+array<long long,MoveSet::NUM_MOVE_TYPES> MoveSet::work_done() const
+{
+    array<long long,NUM_MOVE_TYPES> work;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	work[i] = stepMoveStats[i].sumWork;
+    }
+    return work;
+}
+
+void MoveSet::log_batch_seconds(const array<long long,NUM_MOVE_TYPES>& workBefore,
+	chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    long long batchWork = 0;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	batchWork += stepMoveStats[i].sumWork - workBefore[i];
+    }
+    if(batchWork == 0) {
+	return;
+    }
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	stepMoveStats[i].sumSeconds += 
+		elapsed.count() * (stepMoveStats[i].sumWork - workBefore[i]) / batchWork;
+    }
+}
+
+void MoveSet::adapt_move_probabilities()
+{
+    // The reward for each move type is its cost improvement per unit of work (a proxy for CPU
+    // time) over the last temperature step, relative to the most productive move type. 
+    // (Acceptance alone isn't rewarded - neutral moves are easily accepted but achieve nothing.
+    // Larger moves improve more per attempt but take longer.)
+    double maxImprovement = 0.0;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	maxImprovement = max(maxImprovement, stepMoveStats[i].improvement_per_unit_of_work());
+    }
+    int numApplicable = 0;
+    int bestMoveType = -1;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	if(!moveApplicable[i]) {
+	    continue;
+	}
+	++numApplicable;
+	if(stepMoveStats[i].numAttempts > 0 && maxImprovement > 0.0) {
+	    double reward = stepMoveStats[i].improvement_per_unit_of_work() / maxImprovement;
+	    moveQuality[i] += MOVE_QUALITY_LEARNING_RATE * (reward - moveQuality[i]);
+	}
+	if(bestMoveType < 0 || moveQuality[i] > moveQuality[bestMoveType]) {
+	    bestMoveType = i;
+	}
+    }
+    // Move the probabilities towards the best move type (pursuit) - all other applicable
+    // types head towards the minimum probability. The probabilities still sum to one.
+    double maxProbability = 1.0 - (numApplicable - 1) * MIN_MOVE_PROBABILITY;
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	if(moveApplicable[i]) {
+	    double target = (i == bestMoveType) ? maxProbability : MIN_MOVE_PROBABILITY;
+	    currentMoveProbabilities[i] += 
+		    MOVE_PROBABILITY_ADAPTATION_RATE * (target - currentMoveProbabilities[i]);
+	}
+    }
+    moveDistribution.param(discrete_distribution<int>::param_type(
+	    currentMoveProbabilities.begin(), currentMoveProbabilities.end()));
+
+    accumulate_step_move_stats();
+    adapt_swap_scopes();
+}
+
+void MoveSet::adapt_swap_scopes()
+{
+    // Scope level i is the most local scope whose swaps can change the costs at level i + 1
+    int numLevels = partition->get_all_team_data()->num_levels();
+    double totalCost = costData->get_cost_value();
+    swapScopeProbabilities.assign(numLevels, SWAP_SCOPE_UNIFORM_PROPORTION / numLevels);
+    for(int scopeLevel = 0; scopeLevel < numLevels; ++scopeLevel) {
+	if(totalCost > 0.0) {
+	    swapScopeProbabilities[scopeLevel] += (1.0 - SWAP_SCOPE_UNIFORM_PROPORTION) * 
+		    costData->get_cost_value_at_level(scopeLevel + 1) / totalCost;
+	} else {
+	    swapScopeProbabilities[scopeLevel] = 1.0 / numLevels;
+	}
+    }
+    swapScopeDistribution = discrete_distribution<int>(swapScopeProbabilities.begin(),
+	    swapScopeProbabilities.end());
+}
+
+int MoveSet::get_random_swap_scope()
 {
-    moves[0] = new SwapMembers(this, partition, costData);
-    moves[1] = new MoveMember(this, partition, costData);
+    return swapScopeDistribution(randomNumberGenerator);
+}
+
+void MoveSet::set_cost_guided_swaps(bool enabled)
+{
+    costGuidedSwaps = enabled;
+    if(enabled) {
+	costData->enable_team_cost_weights();
+    }
 }
 
-AnnealMove* MoveSet::get_random_move_type()
+bool MoveSet::cost_guided_swaps() const
 {
-    int randomMoveID = moveDice();
-    return moves[randomMoveID];
+    return costGuidedSwaps;
+}
+
+TeamLevel* MoveSet::get_cost_guided_random_team()
+{
+    // Teams are chosen in proportion to their cost some of the time (if any have a cost) and
+    // uniformly otherwise
+    double choice = random0to1();
+    if(choice < COST_GUIDED_UNIFORM_PROPORTION || !costData->has_team_cost_weights()) {
+	return partition->get_random_team();
+    }
+    return costData->find_team_by_cost_weight(random0to1());
+}
+
+double MoveSet::cost_guided_team_probability(const TeamLevel* team) const
+{
+    double uniformProbability = 1.0 / partition->num_teams_at_lowest_level();
+    if(!costData->has_team_cost_weights()) {
+	return uniformProbability;
+    }
+    return COST_GUIDED_UNIFORM_PROPORTION * uniformProbability + 
+	    (1.0 - COST_GUIDED_UNIFORM_PROPORTION) * costData->team_cost_weight_share(team);
+}
+
+double MoveSet::pending_cost_guided_team_probability(const TeamLevel* team) const
+{
+    double uniformProbability = 1.0 / partition->num_teams_at_lowest_level();
+    CostUnits total = costData->get_pending_team_cost_weights_total();
+    if(total == 0) {
+	return uniformProbability;
+    }
+    return COST_GUIDED_UNIFORM_PROPORTION * uniformProbability + 
+	    (1.0 - COST_GUIDED_UNIFORM_PROPORTION) * 
+	    (double)costData->get_pending_team_cost_weight(team) / total;
+}
+
+void MoveSet::accumulate_step_move_stats()
+{
+    add_move_stats(totalMoveStats, stepMoveStats);
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	stepMoveStats[i].reset();
+    }
 }
 
 void MoveSet::initial_loop()
@@ -145,37 +748,46 @@ void MoveSet::initial_loop()
     vector<double> uphillCosts;
     const int numUphillMovesToLookFor = 200;
     uphillCosts.reserve(numUphillMovesToLookFor);
+    array<long long,NUM_MOVE_TYPES> workBefore = work_done();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 #ifdef DEBUG
     output_cost_data(cout, partition);
 #endif
     while(uphillCosts.size() < numUphillMovesToLookFor) {
-        AnnealMove* move = this->get_random_move_type();
-        double deltaCost = move->generate_and_evaluate_random_move(temperature);
+        bool accepted;
+        double deltaCost = make_random_move(accepted);
 #ifdef DEBUG
 	output_cost_data(cout, partition);
 #endif
 #ifdef RECALCULATE_COSTS_FROM_SCRATCH_TO_DOUBLE_CHECK
-        if(move->accepted()) {
+        if(accepted) {
 	    double cost1 = costData->get_cost_value();
 	    // recalculate cost
 	    costData->initialise_constraint_costs();
 	    double cost2 = costData->get_cost_value();
-	    if(abs(cost1-cost2)/cost1 >= 0.00001) {
+	    // Costs are maintained in fixed point so should match exactly
+	    if(cost1 != cost2) {
 		cerr << "Cost1: " << cost1 << ", Cost2: " << cost2 << endl;
 	    }
-	    assert(abs(cost1-cost2)/cost1 < 0.00001);
+	    assert(cost1 == cost2);
 	}
 #endif
 	if(deltaCost > 0) {
 	    uphillCosts.push_back(deltaCost);
 	}
     }
+    log_batch_seconds(workBefore, start);
     // Now have a set of uphill moves - sort them and work out the 90% point
     sort(uphillCosts.begin(), uphillCosts.end());
     double costAt90Percent = uphillCosts[numUphillMovesToLookFor * 9 / 10];
 
     // We want the probability of accepting moves of this cost to be 70%
     temperature = - costAt90Percent / log(0.7);
+    // The anneal is expected to freeze once even the smallest uphill moves are rarely accepted
+    finalTemperature = - uphillCosts[0] / log(FROZEN_UPHILL_PROBABILITY);
+
+    // All moves are accepted in this loop so they don't tell us which move types are productive
+    accumulate_step_move_stats();
 
 #ifdef DEBUG
     cout << endl << "Completed initial toop - setting temperature to " << temperature << endl;
@@ -183,58 +795,91 @@ void MoveSet::initial_loop()
 #endif
 }
 
-int MoveSet::anneal_inner_loop(int iterations)
+int MoveSet::anneal_inner_loop(int iterations, const AnnealBudget* budget)
 {
     reset_stats();
-    costData->initialise_constraint_costs();
     int movesAccepted = 0;
+    array<long long,NUM_MOVE_TYPES> workBefore = work_done();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 #ifdef DEBUG
     output_cost_data(cout, partition);
 #endif
     for(int i=0; i < iterations; i++) {
-        AnnealMove* move = this->get_random_move_type();
-        move->generate_and_evaluate_random_move(temperature);
-        if(move->accepted()) {
+	if(budget && i % BUDGET_CHECK_INTERVAL == 0 && (costData->at_cost_lower_bound() ||
+		budget->should_stop(numMovesMade, costData->get_cost_value()))) {
+	    break;
+	}
+        bool accepted;
+        make_random_move(accepted);
+        if(accepted) {
             movesAccepted++;
 #ifdef RECALCULATE_COSTS_FROM_SCRATCH_TO_DOUBLE_CHECK
 	    double cost1 = costData->get_cost_value();
 	    // recalculate cost
 	    costData->initialise_constraint_costs();
 	    double cost2 = costData->get_cost_value();
-	    if(abs(cost1-cost2)/cost1 >= 0.00001) {
+	    // Costs are maintained in fixed point so should match exactly
+	    if(cost1 != cost2) {
 		cerr << "Cost1: " << cost1 << ", Cost2: " << cost2 << endl;
 	    }
-	    assert(abs(cost1-cost2)/cost1 < 0.00001);
+	    assert(cost1 == cost2);
 #endif
 	}
     }
+    log_batch_seconds(workBefore, start);
 #ifdef DEBUG
     cout << endl << "Completed inner loop - accepted " << movesAccepted << " of "
             << iterations << " iterations. Uphill prob = " << uphill_probability() <<  endl << endl;
 #endif
+    return movesAccepted;
+}
+
+void MoveSet::restore_lowest_cost_if_worse()
+{
     if(lowestCost < costData->get_cost_value()) {
 	// reset to lowest cost teams found so far
 #ifdef DEBUG
 	cout << "****** Lowest cost: " << lowestCost << " < " << costData->get_cost_value() 
 		<< " - restoring" << endl;
 #endif
-	partition->restore_lowest_cost_teams();
-	costData->initialise_constraint_costs();
-	lowestCost = costData->get_cost_value();
+	costData->restore_lowest_cost_teams();
+	assert(costData->get_cost_value() == lowestCost);
 #ifdef DEBUG
 	cout << "****** New cost: " << lowestCost << endl;
 #endif
+    } else {
+	// Current teams are as good as the lowest cost teams - keep them so that the journal of
+	// changes since the lowest cost doesn't keep growing
+	partition->set_current_teams_as_lowest_cost();
     }
+}
 
-    return movesAccepted;
+void MoveSet::set_temperature(double value)
+{
+    temperature = value;
+}
+
+double MoveSet::get_temperature() const
+{
+    return temperature;
+}
+
+double MoveSet::get_final_temperature() const
+{
+    return finalTemperature;
 }
 
-void MoveSet::reduce_temperature()
+long long MoveSet::get_num_moves_made() const
 {
-        temperature *= 0.98;
+    return numMovesMade;
 }
 
-void MoveSet::do_anneal(AnnealThread* thread)
+double MoveSet::get_lowest_cost() const
+{
+    return lowestCost;
+}
+
+void MoveSet::do_anneal(AnnealTask* task, const CoolingOptions& cooling)
 {
     double probabilityHistory[8] = {1.0,1.0,1.0,1.0,1.0,1.0,1.0,1.0};
     double probabilitySum = 8.0;
@@ -243,48 +888,90 @@ void MoveSet::do_anneal(AnnealThread* thread)
     // Do some initial moves (accepting all by setting the temperature to be 0) 
     // to gather some statistics and work out an appropriate initial temperature
     initial_loop();
+    const AnnealBudget& budget = task->get_budget();
+    CoolingSchedule* schedule = CoolingSchedule::construct(cooling.schedule, temperature,
+	    finalTemperature, partition->num_members());
+
+    // If the anneal stagnates it is reheated to the last temperature at which a reasonable
+    // proportion of uphill moves were accepted
+    int numReheatsLeft = cooling.num_reheats_allowed();
+    double reheatTemperature = temperature;
+    double costAtLastImprovement = costData->get_cost_value();
+    int stepsWithoutImprovement = 0;
 
-    int iterationsPerLoop = partition->num_members() * 4;
+    int iterationsPerLoop = schedule->step_length(1.0);
     int step = 0;
     while(true) {
-        anneal_inner_loop(iterationsPerLoop);
-	if(costData->get_cost_value() == 0.0) {
-	    // Have reached optimal solution
+	long long numMovesBefore = numMovesMade;
+        anneal_inner_loop(iterationsPerLoop, &budget);
+	restore_lowest_cost_if_worse();
+	if(costData->at_cost_lower_bound()) {
+	    // Have reached optimal solution (nothing can cost less)
 	    break;
 	}
-        if(uphill_probability() > 0.7 || uphill_probability() < 0.2) {
-            iterationsPerLoop = partition->num_members() * 4;
-        } else if(uphill_probability() > 0.6 || uphill_probability() < 0.3) {
-            iterationsPerLoop = partition->num_members() * 8;
-        } else {
-            iterationsPerLoop = partition->num_members() * 32;
-        }
-        // Reduce temperature
-	reduce_temperature();
+	if(budget.should_stop(numMovesMade, costData->get_cost_value())) {
+	    // Out of time or moves (or the cost is good enough) - we have the lowest cost teams
+	    break;
+	}
+	if(lowestCost < costAtLastImprovement) {
+	    costAtLastImprovement = lowestCost;
+	    stepsWithoutImprovement = 0;
+	} else {
+	    ++stepsWithoutImprovement;
+	}
+	if(uphill_probability() >= REHEAT_UPHILL_PROBABILITY) {
+	    reheatTemperature = temperature;
+	}
+        // Change the temperature and shift effort towards the move types that are productive
+	double budgetFractionUsed = budget.fraction_used(numMovesMade);
+	temperature = schedule->step_completed(temperature, numMovesMade - numMovesBefore, 
+		uphill_probability(), budgetFractionUsed);
+	iterationsPerLoop = schedule->step_length(uphill_probability());
+	adapt_move_probabilities();
 #ifdef DEBUG
 	cout << endl;
 	cout << "Cost: " << costData->get_cost_value() << endl;
-        cout << "Reducing temperature to " << temperature << endl << endl;
+        cout << "Changing temperature to " << temperature << endl << endl;
 #endif
 
 	probabilitySum -= probabilityHistory[step%8];
 	probabilityHistory[step%8] = uphill_probability();
 	probabilitySum += probabilityHistory[step%8];
 	double probabilityAverage = probabilitySum / 8.0;
-	if(probabilityAverage < 0.0025) {
-	    break;	// give up now - few uphill moves are being accepted
+	bool frozen = (probabilityAverage < FROZEN_UPHILL_PROBABILITY);
+	if(schedule->finished()) {
+	    break;
+	}
+	if(numReheatsLeft > 0 && temperature < reheatTemperature * REHEAT_MIN_TEMPERATURE_RATIO &&
+		(frozen || stepsWithoutImprovement >= REHEAT_STAGNANT_STEPS)) {
+	    // Start again from the lowest cost teams (which are the current teams) at a higher
+	    // temperature
+	    --numReheatsLeft;
+	    temperature = reheatTemperature;
+	    stepsWithoutImprovement = 0;
+	    for(int i = 0; i < 8; ++i) {
+		probabilityHistory[i] = 1.0;
+	    }
+	    probabilitySum = 8.0;
+#ifdef DEBUG
+	    cout << "Stagnated - reheating to " << temperature << endl << endl;
+#endif
+	} else if(frozen) {
+	    break;	// give up now
 	}
 	int nextProgressPercent = (int)floor(100.0 * pow(1.0-probabilityAverage,2));
+	nextProgressPercent = max(nextProgressPercent, (int)(100.0 * budgetFractionUsed));
 	if(nextProgressPercent > progressPercent) {
 	    progressPercent = nextProgressPercent;
 	} // else - can't go backwards
-	thread->update_progress(progressPercent);
+	task->update_progress(progressPercent);
 	++step;
     }
 #ifdef DEBUG
     cout << "Terminated after " << step << " steps" << endl;
 #endif
-    thread->update_progress(100);	// done (100%)
+    delete schedule;
+    task->update_progress(100);	// done (100%)
 }
 
 void MoveSet::reset_stats()
@@ -315,6 +1002,19 @@ double MoveSet::uphill_probability()
     }
 }
 
+void MoveSet::add_move_stats(MoveStats& totals) const
+{
+    add_move_stats(totals, totalMoveStats);
+    add_move_stats(totals, stepMoveStats);
+}
+
+void MoveSet::add_move_stats(MoveStats& totals, const MoveStats& stats)
+{
+    for(int i = 0; i < NUM_MOVE_TYPES; ++i) {
+	totals[i].add(stats[i]);
+    }
+}
+
 void MoveSet::check_for_lowest_cost()
 {
     if(costData->get_cost_value() < lowestCost) {
@@ -6,12 +6,16 @@
 #define MOVESET_HH
 
 #include <array>
+#include <chrono>
 #include <random>
 #include "entity.hh"
 #include "cost.hh"
+#include "random.hh"
+#include "coolingSchedule.hh"
+#include "annealBudget.hh"
 
 class MoveSet;
-class AnnealThread;
+class AnnealTask;
 
 ///////////////////////////////////////////////////////////////////////////////
 // AnnealMove
@@ -21,18 +25,42 @@ protected:
     Partition* partition;
     CostData* costData;
     bool lastMoveAccepted;
+    double acceptanceThreshold;		// largest delta cost that will be accepted for this move
+
+    // Draw the random number which decides whether the move will be accepted and convert it to
+    // the largest acceptable delta cost. This is done before the move is evaluated so that 
+    // evaluation can stop as soon as the move is known to be unacceptable.
+    void set_acceptance_threshold(double temperature);
+    // If the given lower bound on the delta cost of a partly evaluated move exceeds the threshold
+    // then reject the move (undoing the pending cost changes made so far) and return true
+    bool reject_early(double deltaCostLowerBound);
+    // Decide whether a fully evaluated pending move is to be accepted. If not, the pending cost
+    // changes are undone. Statistics are logged either way.
+    bool accept_move(double deltaCost);
+private:
+    void reject_move(double deltaCost);
 public:
     // Constructor
     AnnealMove(MoveSet* moveSet, Partition* partition, CostData* costData);
 
+    // Destructor (virtual)
+    virtual ~AnnealMove();
+
     // Returns deltaCost
     virtual double generate_and_evaluate_random_move(double temperature) = 0;
+    // Returns true if this type of move is possible for the partition's team structure
+    virtual bool is_applicable() const;
     bool accepted();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 // MoveMember
+// Moves a member from one lowest level team to another. Both teams must remain within the
+// size limits of the level. If no such move can be found, no move is made.
 class MoveMember : public AnnealMove {
+private:
+    static const int MAX_ATTEMPTS_TO_FIND_MOVE = 10;
+    bool find_random_move(Member*& member, TeamLevel*& toTeam);
 public:
     // Constructor
     MoveMember(MoveSet* moveSet, Partition* partition, CostData* costData);
@@ -42,7 +70,13 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 // SwapMembers
+// Swaps two members in different lowest level teams. Members with the same signature aren't
+// swapped (it would make no difference to the cost).
 class SwapMembers : public AnnealMove {
+private:
+    static const int MAX_ATTEMPTS_TO_FIND_MOVE = 10;
+    bool find_random_move(Member*& member1, Member*& member2);
+    double pend_swap(Member* member1, Member* member2);
 public:
     // Constructor
     SwapMembers(MoveSet* moveSet, Partition* partition, CostData* costData);
@@ -50,49 +84,180 @@ public:
     double generate_and_evaluate_random_move(double temperature);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// SwapSubteams
+// Swaps two teams (and everything below them) between parents at the same level. Only 
+// applicable if there is more than one level of teams.
+class SwapSubteams : public AnnealMove {
+private:
+    vector<int> swappableLevels;	// levels at which there is more than one parent team
+public:
+    // Constructor
+    SwapSubteams(MoveSet* moveSet, Partition* partition, CostData* costData);
+
+    bool is_applicable() const;
+    double generate_and_evaluate_random_move(double temperature);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// RotateMembers
+// Moves members around a chain of distinct lowest level teams. For a cycle, the member from
+// each team moves to the next team and the member from the last team moves to the first
+// (A->B->C->A) so team sizes are unchanged. For an ejection chain, the member from each team
+// moves to the next team and the last team just receives a member (A->B->C->D) so the first
+// team shrinks and the last grows - both must stay within the level's size limits. If no
+// chain can be found, no move is made.
+class RotateMembers : public AnnealMove {
+private:
+    static const int MIN_CHAIN_TEAMS = 3;
+    static const int MAX_CHAIN_TEAMS = 4;
+    static const int MAX_ATTEMPTS_TO_FIND_MOVE = 10;
+    bool ejectionChain;
+    vector<Member*> chainMembers;	// member to move from each team (none from the last team
+    					// in an ejection chain)
+    vector<TeamLevel*> chainTeams;	// teams in the chain, in order
+    bool team_in_chain(const TeamLevel* team) const;
+    bool find_random_chain(int numTeams);
+public:
+    // Constructor
+    RotateMembers(MoveSet* moveSet, Partition* partition, CostData* costData, bool ejectionChain);
+
+    bool is_applicable() const;
+    double generate_and_evaluate_random_move(double temperature);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// MoveTypeStats
+// Statistics for moves of one type
+class MoveTypeStats {
+public:
+    long numAttempts;
+    long numAccepted;
+    double sumImprovement;	// total cost reduction from accepted downhill moves
+    double sumSeconds;		// time spent making and evaluating moves (estimated - see
+    				// log_batch_seconds())
+    // Work done making and evaluating moves - the number of constraint costs evaluated plus 
+    // one per attempt. Unlike the time taken this doesn't vary from run to run so adapting
+    // to it keeps runs with the same random seed reproducible.
+    long long sumWork;
+
+    // Constructor
+    MoveTypeStats();
+
+    void reset();
+    void log_move(double deltaCost, bool accepted, long long work);
+    void add(const MoveTypeStats& other);
+    double acceptance_rate() const;
+    double improvement_per_unit_of_work() const;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // MoveSet
 class MoveSet {
 public:
-    typedef enum {SWAP, MOVE} Type;
+    typedef enum {SWAP, MOVE, SWAP_SUBTEAMS, ROTATE, EJECTION_CHAIN} Type;
+    static const int NUM_MOVE_TYPES = 5;
+    static const char* moveTypeNames[NUM_MOVE_TYPES];
+    typedef array<MoveTypeStats,NUM_MOVE_TYPES> MoveStats;
 private:
     Partition* partition;
     CostData* costData;
     double temperature;
+    double finalTemperature;	// estimated in the initial loop
+    long long numMovesMade;
     double lowestCost;
 
-    static array<double,2> moveProbabilities;
-    mt19937 randomNumberGenerator;
+    static array<double,NUM_MOVE_TYPES> moveProbabilities;	// initial probabilities - moves which
+    								// are not applicable to a partition
+								// will not be used
+    RandomGenerator randomNumberGenerator;
     discrete_distribution<int> moveDistribution;
-    uniform_real_distribution<double> uniform0to1Distribution;
-    array<AnnealMove*,2> moves;
+    array<AnnealMove*,NUM_MOVE_TYPES> moves;
+
+    // Adaptive move selection (adaptive pursuit). Probabilities are moved towards the move type
+    // with the highest estimated quality at each temperature step
+    array<bool,NUM_MOVE_TYPES> moveApplicable;
+    array<double,NUM_MOVE_TYPES> currentMoveProbabilities;
+    array<double,NUM_MOVE_TYPES> moveQuality;
+
+    // Swaps choose the second member from within the ancestor of the first member's team at a
+    // random level (the swap scope - level 0 is the whole partition). A swap within a scope only
+    // changes the costs of constraints at lower levels so each scope is chosen in proportion to
+    // the cost of the constraints at the level just below it (mixed with a uniform choice so 
+    // that every scope is tried). Indexed by level number.
+    vector<double> swapScopeProbabilities;
+    discrete_distribution<int> swapScopeDistribution;
+
+    // If true, the first member of a swap is chosen from a lowest level team chosen with 
+    // probability proportional to the cost of its constraints (see cost_guided_team_probability())
+    bool costGuidedSwaps;
 
 private:	// Statistics related
     double sumAcceptedUphillCosts;
     int numUphillMovesAccepted;
     int numUphillMovesRejected;
+    MoveStats stepMoveStats;		// since the move probabilities were last adapted
+    MoveStats totalMoveStats;
+    void accumulate_step_move_stats();	// add step stats to the totals and reset them
+    // Moves are too quick to time individually so the time taken by a batch of moves is shared
+    // between the move types in proportion to the work each did in the batch (the work done by
+    // each type before the batch is given)
+    array<long long,NUM_MOVE_TYPES> work_done() const;
+    void log_batch_seconds(const array<long long,NUM_MOVE_TYPES>& workBefore, 
+	    chrono::steady_clock::time_point start);
 public:
-    function<int()> moveDice;
-    function<double()> random0to1Dice;
-public:
-    // Constructor
-    MoveSet(Partition* partition, CostData* costData);
-    AnnealMove* get_random_move_type();
+    // Constructor. The random numbers used depend on the partition's number and the copy number
+    // so that move sets for different copies of a partition (e.g. replicas) make different moves.
+    MoveSet(Partition* partition, CostData* costData, unsigned int copyNum = 0);
+
+    // Destructor
+    ~MoveSet();
+
+    MoveSet::Type get_random_move_type();
+    double random0to1();		// uniformly distributed in [0,1)
+    // Make a move of a random type and log the outcome. Returns the delta cost.
+    double make_random_move(bool& accepted);
+    // Reweight the move type probabilities based on the statistics since the last call (and
+    // the swap scope probabilities based on the current costs)
+    void adapt_move_probabilities();
+    void adapt_swap_scopes();
+    int get_random_swap_scope();	// level number
+
+    // Cost guided swap proposals
+    void set_cost_guided_swaps(bool enabled);
+    bool cost_guided_swaps() const;
+    TeamLevel* get_cost_guided_random_team();
+    // Probability that get_cost_guided_random_team() returns the given team - now, or once the 
+    // pending changes are committed
+    double cost_guided_team_probability(const TeamLevel* team) const;
+    double pending_cost_guided_team_probability(const TeamLevel* team) const;
     // Undertake the initial loop (all moves accepted) and set the initial temperature
     void initial_loop();
-    // Returns number of iterations which resulted in moves being accepted
-    int anneal_inner_loop(int iterations);
+    // Returns number of iterations which resulted in moves being accepted. If a budget is given,
+    // stops early if it says to or the cost reaches its lower bound.
+    int anneal_inner_loop(int iterations, const AnnealBudget* budget = nullptr);
+    long long get_num_moves_made() const;
+    // If the current teams are worse than the lowest cost teams found so far, go back to
+    // the lowest cost teams
+    void restore_lowest_cost_if_worse();
 
-    void reduce_temperature();
+    void set_temperature(double value);
+    double get_temperature() const;
+    // Estimate (from the initial loop) of the temperature at which the anneal freezes
+    double get_final_temperature() const;
+    double get_lowest_cost() const;
 
-    // Undertake the anneal
-    void do_anneal(AnnealThread* thread);
+    // Undertake the anneal, using the given cooling schedule and reheating options
+    void do_anneal(AnnealTask* task, const CoolingOptions& cooling);
 
     // Statistics functions. Statistics should be reset before every inner/initial loop
     void reset_stats();
     void log_cost(double deltaCost, bool accepted);
     // Since stats were reset - return the probability that uphill moves were accepted
     double uphill_probability();
+    // Add our statistics for each move type to the given totals
+    void add_move_stats(MoveStats& totals) const;
+    static void add_move_stats(MoveStats& totals, const MoveStats& stats);
 
     // Check if the current cost is the lowest and if so, record it and keep a copy of that
     // team membership
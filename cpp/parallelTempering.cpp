@@ -0,0 +1,235 @@
+//
+// parallelTempering.cpp
+//
+
+#include "parallelTempering.hh"
+#include "anneal.hh"
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "assert.h"
+
+// Coldest temperature in the ladder as a fraction of the hottest (initial) temperature - only
+// used if the temperature at which the anneal freezes can't be estimated
+static const double COLDEST_TEMPERATURE_RATIO = 0.01;
+// The coldest rung is frozen when, over this many rounds, the replica there hasn't lowered its
+// cost and hardly any uphill moves have been accepted there (on average)
+static const int FROZEN_ROUNDS = 8;
+static const double FROZEN_UPHILL_PROBABILITY = 0.0025;
+// Once the coldest rung is frozen we stop when the lowest cost hasn't improved for as many
+// rounds as it took to find (but at least this many)
+static const int MIN_ROUNDS_WITHOUT_IMPROVEMENT = 20;
+// Stop after this many rounds regardless
+static const int MAX_ROUNDS = 2000;
+
+///////////////////////////////////////////////////////////////////////////////
+// ParallelTempering
+
+// Constructor
+ParallelTempering::ParallelTempering(Partition* partition, CostData* costData, int numReplicas,
+		unsigned int firstCopyNum, bool costGuidedSwaps) :
+	partition(partition),
+	costData(costData),
+	numReplicas(numReplicas),
+	firstCopyNum(firstCopyNum),
+	costGuidedSwaps(costGuidedSwaps),
+	randomNumberGenerator(RandomGenerator::PARALLEL_TEMPERING, partition->get_partition_number(),
+		firstCopyNum),
+	numExchangesAttempted(0),
+	numExchangesAccepted(0)
+{
+    assert(numReplicas > 1);
+}
+
+// Destructor
+ParallelTempering::~ParallelTempering()
+{
+    for(unsigned int i = 0; i < replicaMoveSets.size(); ++i) {
+	delete replicaMoveSets[i];
+    }
+    // Replica 0 is the original partition - this isn't ours to delete
+    for(unsigned int i = 1; i < replicas.size(); ++i) {
+	delete replicaCostData[i];
+	delete replicas[i];
+    }
+}
+
+void ParallelTempering::create_replicas()
+{
+    // Replica 0 is the original partition - the others start as copies of its current teams
+    replicas.push_back(partition);
+    replicaCostData.push_back(costData);
+    replicaMoveSets.push_back(new MoveSet(partition, costData, firstCopyNum));
+    // Do some initial moves to work out an appropriate initial temperature
+    replicaMoveSets[0]->initial_loop();
+
+    for(int i = 1; i < numReplicas; ++i) {
+	Partition* replica = partition->create_replica(firstCopyNum + i);
+	CostData* replicaCost = new CostData(costData->annealInfo, replica);
+	replicas.push_back(replica);
+	replicaCostData.push_back(replicaCost);
+	replicaMoveSets.push_back(new MoveSet(replica, replicaCost, firstCopyNum + i));
+    }
+    for(int i = 0; i < numReplicas; ++i) {
+	replicaMoveSets[i]->set_cost_guided_swaps(costGuidedSwaps);
+    }
+}
+
+// Temperatures decrease geometrically from the hottest to the coldest
+void ParallelTempering::set_up_temperature_ladder(double hottest, double coldest)
+{
+    if(coldest <= 0.0 || coldest >= hottest) {
+	coldest = hottest * COLDEST_TEMPERATURE_RATIO;
+    }
+    double ratio = pow(coldest / hottest, 1.0 / (numReplicas - 1));
+    double temperature = hottest;
+    for(int rung = 0; rung < numReplicas; ++rung) {
+	temperatures.push_back(temperature);
+	replicaAtRung.push_back(rung);
+	temperature *= ratio;
+    }
+}
+
+// Run the given number of iterations on every replica (each in its own thread) at their
+// current temperatures
+void ParallelTempering::run_round(int iterations, const AnnealBudget& budget)
+{
+    vector<thread> threads;
+    for(int rung = 0; rung < numReplicas; ++rung) {
+	MoveSet* moveSet = replicaMoveSets[replicaAtRung[rung]];
+	moveSet->set_temperature(temperatures[rung]);
+	threads.push_back(thread(&MoveSet::anneal_inner_loop, moveSet, iterations, &budget));
+    }
+    for(unsigned int i = 0; i < threads.size(); ++i) {
+	threads[i].join();
+    }
+    for(int i = 0; i < numReplicas; ++i) {
+	replicaMoveSets[i]->adapt_move_probabilities();
+    }
+}
+
+void ParallelTempering::exchange_replicas(int firstRung)
+{
+    for(int rung = firstRung; rung + 1 < numReplicas; rung += 2) {
+	int hotter = replicaAtRung[rung];
+	int colder = replicaAtRung[rung+1];
+	double hotterCost = replicaCostData[hotter]->get_cost_value();
+	double colderCost = replicaCostData[colder]->get_cost_value();
+	// Metropolis criterion - lower cost replicas always move to the colder temperature
+	double exponent = (1.0 / temperatures[rung] - 1.0 / temperatures[rung+1]) * 
+		(hotterCost - colderCost);
+	++numExchangesAttempted;
+	if(exponent >= 0.0 || randomNumberGenerator.uniform0to1() < exp(exponent)) {
+	    replicaAtRung[rung] = colder;
+	    replicaAtRung[rung+1] = hotter;
+	    ++numExchangesAccepted;
+	}
+    }
+}
+
+int ParallelTempering::lowest_cost_replica() const
+{
+    int best = 0;
+    for(int i = 1; i < numReplicas; ++i) {
+	if(replicaMoveSets[i]->get_lowest_cost() < replicaMoveSets[best]->get_lowest_cost()) {
+	    best = i;
+	}
+    }
+    return best;
+}
+
+void ParallelTempering::do_anneal(AnnealTask* task)
+{
+    int progressPercent = 0;
+    const AnnealBudget& budget = task->get_budget();
+
+    create_replicas();
+    // The coldest rung is where the normal anneal would freeze, so the replica there is 
+    // effectively quenched
+    set_up_temperature_ladder(replicaMoveSets[0]->get_temperature(), 
+	    replicaMoveSets[0]->get_final_temperature());
+
+    int iterationsPerRound = partition->num_members() * 4;
+    double lowestCost = replicaMoveSets[lowest_cost_replica()]->get_lowest_cost();
+    int roundsToLastImprovement = 0;
+    int roundsWithoutImprovement = 0;
+    // Recent history of the coldest rung (to tell when it has frozen)
+    vector<double> coldestUphillProbabilities(FROZEN_ROUNDS, 1.0);
+    double lowestColdestCost = numeric_limits<double>::max();
+    int roundsColdestUnchanged = 0;
+    for(int round = 0; round < MAX_ROUNDS; ++round) {
+	run_round(iterationsPerRound, budget);
+	int coldestReplica = replicaAtRung[numReplicas - 1];
+	coldestUphillProbabilities[round % FROZEN_ROUNDS] = 
+		replicaMoveSets[coldestReplica]->uphill_probability();
+	// Alternate between exchanging even and odd pairs of rungs
+	exchange_replicas(round % 2);
+
+	// The cost at the coldest rung can fall from its own moves or from a lower cost replica
+	// arriving in the exchange
+	double coldestCost = replicaCostData[replicaAtRung[numReplicas - 1]]->get_cost_value();
+	if(coldestCost < lowestColdestCost) {
+	    lowestColdestCost = coldestCost;
+	    roundsColdestUnchanged = 0;
+	} else {
+	    ++roundsColdestUnchanged;
+	}
+	double sumUphillProbabilities = 0.0;
+	for(int i = 0; i < FROZEN_ROUNDS; ++i) {
+	    sumUphillProbabilities += coldestUphillProbabilities[i];
+	}
+	bool coldestFrozen = (roundsColdestUnchanged >= FROZEN_ROUNDS &&
+		sumUphillProbabilities / FROZEN_ROUNDS < FROZEN_UPHILL_PROBABILITY);
+
+	double lowestCostThisRound = replicaMoveSets[lowest_cost_replica()]->get_lowest_cost();
+	long long numMovesMade = 0;
+	for(int i = 0; i < numReplicas; ++i) {
+	    numMovesMade += replicaMoveSets[i]->get_num_moves_made();
+	}
+	if(lowestCostThisRound <= costData->get_cost_lower_bound()) {
+	    // Have reached optimal solution (nothing can cost less)
+	    break;
+	} else if(budget.should_stop(numMovesMade, lowestCostThisRound)) {
+	    break;	// out of time or moves (or the cost is good enough)
+	} else if(lowestCostThisRound < lowestCost) {
+	    lowestCost = lowestCostThisRound;
+	    roundsToLastImprovement = round + 1;
+	    roundsWithoutImprovement = 0;
+	} else {
+	    ++roundsWithoutImprovement;
+	}
+	int roundsNeeded = max(roundsToLastImprovement, MIN_ROUNDS_WITHOUT_IMPROVEMENT);
+	if(coldestFrozen && roundsWithoutImprovement >= roundsNeeded) {
+	    break;	// give up now - no replica is finding better teams
+	}
+	int nextProgressPercent = max(100 * roundsWithoutImprovement / roundsNeeded,
+		(int)(100.0 * budget.fraction_used(numMovesMade)));
+	if(nextProgressPercent > progressPercent && nextProgressPercent < 100) {
+	    progressPercent = nextProgressPercent;
+	} // else - can't go backwards
+	task->update_progress(progressPercent);
+    }
+#ifdef DEBUG
+    cout << "Replica exchanges accepted " << numExchangesAccepted << " of " 
+	    << numExchangesAttempted << endl;
+#endif
+
+    // Copy the lowest cost teams found by any replica back to the original partition
+    int best = lowest_cost_replica();
+    replicas[best]->restore_lowest_cost_teams();
+    if(best != 0) {
+	partition->copy_teams_from(replicas[best]);
+	partition->set_current_teams_as_lowest_cost();
+    }
+    costData->initialise_constraint_costs();
+
+    task->update_progress(100);	// done (100%)
+}
+
+void ParallelTempering::add_move_stats(MoveSet::MoveStats& totals) const
+{
+    for(unsigned int i = 0; i < replicaMoveSets.size(); ++i) {
+	replicaMoveSets[i]->add_move_stats(totals);
+    }
+}
@@ -0,0 +1,66 @@
+//
+// parallelTempering.hh
+//
+
+#ifndef PARALLELTEMPERING_HH
+#define PARALLELTEMPERING_HH
+
+#include "entity.hh"
+#include "cost.hh"
+#include "moveSet.hh"
+#include "random.hh"
+#include <vector>
+
+class AnnealTask;
+
+///////////////////////////////////////////////////////////////////////////////
+// ParallelTempering
+//
+// Replica exchange annealing of a single partition. Replicas of the partition (each with
+// their own cost data and move set) are annealed concurrently, each at a fixed temperature
+// from a geometric ladder (from the initial temperature down to the temperature at which the
+// anneal is expected to freeze). After each round of moves, replicas at neighbouring temperatures
+// swap temperatures with the Metropolis probability. The lowest cost teams found by any
+// replica are copied back to the original partition.
+
+class ParallelTempering {
+private:
+    Partition* partition;		// original partition - this is also replica 0
+    CostData* costData;
+    int numReplicas;
+    unsigned int firstCopyNum;		// copy number of the original partition
+    bool costGuidedSwaps;		// passed on to each replica's move set
+    vector<Partition*> replicas;
+    vector<CostData*> replicaCostData;
+    vector<MoveSet*> replicaMoveSets;
+    vector<double> temperatures;	// temperature ladder - hottest first
+    vector<int> replicaAtRung;		// replica currently at each temperature in the ladder
+    RandomGenerator randomNumberGenerator;
+
+    // Statistics
+    int numExchangesAttempted;
+    int numExchangesAccepted;
+
+    void create_replicas();
+    void set_up_temperature_ladder(double hottest, double coldest);
+    void run_round(int iterations, const AnnealBudget& budget);
+    // Attempt exchanges between rungs firstRung and firstRung+1, firstRung+2 and firstRung+3, ...
+    void exchange_replicas(int firstRung);
+    int lowest_cost_replica() const;
+public:
+    // Constructor. Replicas are numbered as copies of the partition (which determines the random
+    // numbers they use) from the given copy number (which the original partition uses).
+    ParallelTempering(Partition* partition, CostData* costData, int numReplicas,
+	    unsigned int firstCopyNum = 0, bool costGuidedSwaps = false);
+
+    // Destructor - deletes all replicas (except the original partition)
+    ~ParallelTempering();
+
+    // Undertake the anneal
+    void do_anneal(AnnealTask* task);
+
+    // Add the move statistics of all replicas to the given totals
+    void add_move_stats(MoveSet::MoveStats& totals) const;
+};
+
+#endif
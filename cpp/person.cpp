@@ -3,43 +3,40 @@
 
 using namespace std;
 
-Person::Person(const string& id) :
-	id(id) 
+Person::Person(const string& id, int number) :
+	id(id),
+	number(number)
 {
 }
 
-void Person::add_attribute_value_pair(const Attribute* attr, int attributeValueIndex)
+void Person::add_attribute_value_pair(Attribute* attr, int attributeValueIndex)
 {
-    // Add the value to the set of string attributes for this person
-    stringAttributes.insert( pair<const Attribute*,int>(attr, attributeValueIndex) );
+    // Add the value to the attribute's column of string value indices
+    attr->set_value_index_for_person(number, attributeValueIndex);
 }
 
-void Person::add_attribute_value_pair(const Attribute* attr, double numValue) 
+void Person::add_attribute_value_pair(Attribute* attr, double numValue) 
 {
-    // Add the value to the set of string attributes for this person
-    numberAttributes.insert( pair<const Attribute*,double>(attr, numValue) );
+    // Add the value to the attribute's column of numeric values
+    attr->set_numeric_value_for_person(number, numValue);
 }
 
 const string& Person::get_string_attribute_value(const Attribute* attr) const
 {
-    map<const Attribute*,int>::const_iterator it = stringAttributes.find(attr);
-    assert(it != stringAttributes.end()); 	// We must have found it
-    const string& attributeValue = attr->get_string_value(it->second);
-    return attributeValue;
+    assert(attr->has_value_for_person(number)); 	// We must have a value
+    return attr->get_string_value(attr->valueIndexColumn[number]);
 }
 
 int Person::get_string_attribute_index(const Attribute* attr) const
 {
-    map<const Attribute*,int>::const_iterator it = stringAttributes.find(attr);
-    assert(it != stringAttributes.end()); 	// We must have found it
-    return it->second;
+    assert(attr->has_value_for_person(number)); 	// We must have a value
+    return attr->valueIndexColumn[number];
 }
 
 double Person::get_numeric_attribute_value(const Attribute* attr) const
 {
-    map<const Attribute*,double>::const_iterator it = numberAttributes.find(attr);
-    assert(it != numberAttributes.end()); 	// We must have found it
-    return it->second;
+    assert(attr->is_numeric() && number < (int)attr->numericColumn.size());
+    return attr->numericColumn[number];
 }
 
 const string& Person::get_id() const
@@ -47,6 +44,11 @@ const string& Person::get_id() const
     return id;
 }
 
+int Person::get_number() const
+{
+    return number;
+}
+
 bool Person::has_id(const string& name) const
 {
     return (id.compare(name) == 0);
@@ -55,18 +57,15 @@ bool Person::has_id(const string& name) const
 bool Person::has_attribute(const Attribute* attr) const
 {
     assert(attr);
-    map<const Attribute*,int>::const_iterator it = stringAttributes.find(attr);
-    return (it != stringAttributes.end());
+    return attr->has_value_for_person(number);
 }
 
 bool Person::has_attribute_value_pair(const Attribute* attr, const string& strValue) const
 {
     assert(attr);
-    map<const Attribute*,int>::const_iterator it = stringAttributes.find(attr);
-    if(it != stringAttributes.end()) {
-	const string& attributeValue = attr->get_string_value(it->second);
+    if(attr->has_value_for_person(number)) {
 	// Found the attribute - check if the value is a match
-	return (strValue == attributeValue);
+	return (strValue == attr->get_string_value(attr->valueIndexColumn[number]));
     } else {
 	// Attribute not found - can't match
 	return false;
@@ -75,18 +74,7 @@ bool Person::has_attribute_value_pair(const Attribute* attr, const string& strVa
 
 ostream& operator<<(ostream& os, const Person& p) 
 {
-    os << p.id;
-    os << endl << "String attributes " << p.stringAttributes.size() << ":" << endl;
-    for(map<const Attribute*,int>::const_iterator i = p.stringAttributes.begin(); 
-            i != p.stringAttributes.end(); i++) {
-	const string& attributeValue = i->first->get_string_value(i->second);
-        os << "  " << i->first->get_name() << " : " << attributeValue << endl;
-    }
-    os << "Numerical attributes " << p.numberAttributes.size() << ":" << endl;
-    for(map<const Attribute*,double>::const_iterator i = p.numberAttributes.begin(); 
-            i != p.numberAttributes.end(); i++) {
-        os << "  " << i->first->get_name() << " : " << i->second << endl;
-    }
+    // Attribute values are held by the attributes so we just identify the person
+    os << p.id << " (person " << p.number << ")" << endl;
     return os;
 }
-
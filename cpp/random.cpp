@@ -0,0 +1,58 @@
+//
+// random.cpp
+//
+
+#include "random.hh"
+#include <random>
+
+using namespace std;
+
+// Default master seed (if none is set) - a different one for every run
+static uint64_t default_master_seed()
+{
+#ifdef CONSTANT_RANDOM_SEED
+    return 0;
+#else
+    random_device device;
+    return ((uint64_t)device() << 32) ^ device();
+#endif
+}
+
+static uint64_t masterSeed = default_master_seed();
+
+void set_master_random_seed(uint64_t seed)
+{
+    masterSeed = seed;
+}
+
+uint64_t get_master_random_seed()
+{
+    return masterSeed;
+}
+
+// splitmix64 - advances the given state and returns the next (well mixed) value. This is used
+// to derive seeds - similar inputs give unrelated outputs.
+static uint64_t splitmix64(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RandomGenerator
+
+// Constructor
+RandomGenerator::RandomGenerator(Role role, unsigned int partitionNum, unsigned int copyNum)
+{
+    // Mix each part of the stream identity into the master seed then expand it into the state
+    // (which can't be all zero - splitmix64 outputs from a sequence never are)
+    uint64_t x = masterSeed;
+    x = splitmix64(x) ^ (uint64_t)role;
+    x = splitmix64(x) ^ partitionNum;
+    x = splitmix64(x) ^ copyNum;
+    for(int i = 0; i < 4; ++i) {
+	state[i] = splitmix64(x);
+    }
+}
@@ -0,0 +1,72 @@
+//
+// random.hh
+//
+
+#ifndef RANDOM_HH
+#define RANDOM_HH
+
+#include <cstdint>
+
+// The seeds of all random number generators are derived from a master seed so that runs with 
+// the same master seed are reproducible. This must be set before any generators are created.
+// (By default it is chosen randomly for each run.)
+void set_master_random_seed(uint64_t seed);
+uint64_t get_master_random_seed();
+
+///////////////////////////////////////////////////////////////////////////////
+// RandomGenerator
+//
+// xoshiro256** pseudo random number generator. Every object which needs random numbers owns
+// its own generator (generators are not shared between threads). Each is seeded with its own 
+// stream - identified by the role of the owner, the partition number and the copy number of 
+// the partition (for restarts and replicas) - so the random numbers an object uses don't 
+// depend on the order in which objects are created. Satisfies the requirements of a uniform
+// random bit generator so it can be used with the standard distributions and algorithms.
+
+class RandomGenerator {
+public:
+    typedef uint64_t result_type;
+    typedef enum {PARTITION, MOVE_SET, PARALLEL_TEMPERING} Role;
+private:
+    uint64_t state[4];
+public:
+    // Constructor
+    RandomGenerator(Role role, unsigned int partitionNum, unsigned int copyNum);
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+    result_type operator()();
+
+    double uniform0to1();	// uniformly distributed in [0,1)
+    int uniform_int(int n);	// uniformly distributed in 0 to n-1 (n must be positive)
+};
+
+// The generator is called for every move so these are defined here to allow them to be inlined
+
+inline RandomGenerator::result_type RandomGenerator::operator()()
+{
+    uint64_t result = state[1] * 5;
+    result = ((result << 7) | (result >> 57)) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = (state[3] << 45) | (state[3] >> 19);
+    return result;
+}
+
+inline double RandomGenerator::uniform0to1()
+{
+    // Top 53 bits give every double in [0,1) which is a multiple of 2^-53
+    return ((*this)() >> 11) * (1.0 / (1ULL << 53));
+}
+
+inline int RandomGenerator::uniform_int(int n)
+{
+    // Lemire's multiply and shift - the bias (at most n/2^32) is negligible for our sizes
+    return (int)((((*this)() >> 32) * (uint64_t)n) >> 32);
+}
+
+#endif
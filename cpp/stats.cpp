@@ -15,6 +15,8 @@ static JSONObject* statsJSON = nullptr;
 // Elements within the above
 static JSONArray* partitionStatsArray = nullptr;
 static JSONString* endTime = nullptr;
+// Move statistics for each partition (if annealed) - added to the partition stats
+static map<const Partition*,JSONArray*> partitionMoveStats;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Local functions
@@ -109,6 +111,14 @@ static void stats_add_partition_stats(Partition* partition)
 
     CostData* costData = allCostData->get_cost_data_for_partition(partition);
 
+    // Output the cost and how far it could be from the best possible (the lower bound may
+    // not be achievable so a gap doesn't mean better teams exist)
+    double cost = costData->get_cost_value();
+    double costLowerBound = costData->get_cost_lower_bound();
+    partitionStats->append("cost", cost);
+    partitionStats->append("cost-lower-bound", costLowerBound);
+    partitionStats->append("optimality-gap", max(cost - costLowerBound, 0.0));
+
     // Output details of constraint performance
     JSONArray* constraintStats = stats_constraint_performance(partition, costData);
     partitionStats->append("constraint-performance", constraintStats);
@@ -117,6 +127,12 @@ static void stats_add_partition_stats(Partition* partition)
     JSONArray* teamStats = stats_team_stats(partition, costData);
     partitionStats->append("teams", teamStats);
 
+    // Output details of the moves made (if the partition was annealed)
+    map<const Partition*,JSONArray*>::iterator moveStatsItr = partitionMoveStats.find(partition);
+    if(moveStatsItr != partitionMoveStats.end()) {
+	partitionStats->append("move-stats", moveStatsItr->second);
+    }
+
     partitionStatsArray->append(partitionStats);
 }
 
@@ -154,6 +170,27 @@ void stats_add_for_all_partitions(AllTeamData* teamData)
     }
 }
 
+void stats_add_move_stats(Partition* partition, const MoveSet::MoveStats& moveStats)
+{
+    long totalAttempts = 0;
+    for(int i = 0; i < MoveSet::NUM_MOVE_TYPES; ++i) {
+	totalAttempts += moveStats[i].numAttempts;
+    }
+    JSONArray* moveStatsArray = new JSONArray();
+    for(int i = 0; i < MoveSet::NUM_MOVE_TYPES; ++i) {
+	JSONObject* moveTypeStats = new JSONObject();
+	moveTypeStats->append("move", string(MoveSet::moveTypeNames[i]));
+	moveTypeStats->append("attempts", (double)moveStats[i].numAttempts);
+	moveTypeStats->append("accepted", (double)moveStats[i].numAccepted);
+	moveTypeStats->append("improvement", moveStats[i].sumImprovement);
+	moveTypeStats->append("seconds", moveStats[i].sumSeconds);
+	moveTypeStats->append("share-of-attempts", 
+		(totalAttempts > 0) ? (double)moveStats[i].numAttempts / totalAttempts : 0.0);
+	moveStatsArray->append(moveTypeStats);
+    }
+    partitionMoveStats[partition] = moveStatsArray;
+}
+
 void stats_output(ostream& os)
 {
     os << *statsJSON;
@@ -8,6 +8,7 @@
 #include <string>
 #include "entity.hh"
 #include "teamData.hh"
+#include "moveSet.hh"
 #include <ostream>
 
 using namespace std;
@@ -17,6 +18,8 @@ void stats_init(const string& inputCSVFileName,
 		      const string& outputCSVFileName);
 void stats_set_end_time();
 void stats_add_for_all_partitions(AllTeamData* data);
+// Record the move statistics for a partition - output with the other stats for the partition
+void stats_add_move_stats(Partition* partition, const MoveSet::MoveStats& moveStats);
 void stats_output(ostream& os);
 
 
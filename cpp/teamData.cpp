@@ -28,14 +28,15 @@ AllTeamData::AllTeamData(AnnealInfo& annealInfo) :
 	    // itr will be a const string*
 	    // Create a new partition with the given name. The associated level is level 0.
 	    Partition* partition = new Partition(this, get_level(0), *itr, 
-		    annealInfo.count_people_with_attribute_value(partitionAttribute, *itr));
+		    annealInfo.count_people_with_attribute_value(partitionAttribute, *itr),
+		    partitionList.size());
 	    partitionMap.insert(pair<const string,Partition*>(*itr, partition));
 	    partitionList.append(partition);
 	}
     } else {
 	// No partitions - just create one with an empty name
 	string* partitionNamePtr = new string("");
-	partition = new Partition(this, get_level(0), *partitionNamePtr, annealInfo.num_people());
+	partition = new Partition(this, get_level(0), *partitionNamePtr, annealInfo.num_people(), 0);
 	partitionMap.insert(pair<const string, Partition*>("", partition));
 	partitionList.append(partition);
     }
@@ -17,10 +17,16 @@
 #include "stats.hh"
 #include "moveStats.hh"
 #include "anneal.hh"
+#include "exceptions.hh"
+#include "random.hh"
 #include <fstream>
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <iostream>
-#include <stdlib.h>	// for exit()
+#include <stdlib.h>	// for exit(), strtol(), strtoull(), strtod()
+#include <math.h>	// for isinf()
+#include <signal.h>
 
 using namespace std;
 
@@ -41,9 +47,39 @@ static void print_help_message(const char* progName)
     cout << "Subcommands are:\n\
 help\n\
     - output this message to standard output\n\
-create input-team-csv-file constraint-json-file output-team-csv-file\n\
+create [options] input-team-csv-file constraint-json-file output-team-csv-file\n\
     - performs simulated annealing to create new teams. Outputs JSON stats to stdout\n\
       when complete. Outputs progress messages to stderr whilst in progress.\n\
+      Options are:\n\
+        --cooling SCHEDULE\n\
+                         - cooling schedule: default (the same as geometric), geometric,\n\
+                           lundy-mees or lam (adaptive - follows a target uphill\n\
+                           acceptance trajectory over a fixed number of moves). Not used\n\
+                           with --replicas. Overrides the schedule given in the constraint\n\
+                           file (if any), including when default is given.\n\
+        --cost-guided-swaps\n\
+                         - choose the first member of each swap from a team chosen with\n\
+                           probability based on the cost of its constraints. Acceptance\n\
+                           is corrected for the biased choice, but only approximately.\n\
+        --jobs N         - anneal at most N partitions at once (default is the number\n\
+                           of hardware threads). Largest partitions are started first.\n\
+        --max-moves N    - stop annealing each partition after N moves\n\
+        --pin-threads    - pin each worker thread to its own CPU core\n\
+        --reheats N      - reheat the anneal up to N times when it stagnates (default 0).\n\
+                           Overrides the number given in the constraint file (if any).\n\
+        --replicas K     - anneal each partition by parallel tempering (replica exchange)\n\
+                           with K replicas at a ladder of temperatures, each in its own\n\
+                           thread\n\
+        --restarts N     - anneal each partition N times (concurrently) from different\n\
+                           random initial teams and keep the lowest cost result\n\
+        --seed N         - seed the random number generators with N (a non-negative\n\
+                           integer) - runs with the same seed and options give the\n\
+                           same teams. (The seed used is always output to stderr.)\n\
+        --target-cost C  - stop annealing each partition once its cost is C or less\n\
+        --time-limit S   - stop annealing S seconds after starting (S may be fractional).\n\
+                           Cooling schedules are fitted to the time and/or move limits.\n\
+                           The lowest cost teams found are output when annealing stops,\n\
+                           including when it is interrupted (SIGINT or SIGTERM).\n\
 evaluate team-csv-file constraint-json-file\n\
     - takes a populated team file (which should be the result of annealing/editing) and\n\
       outputs JSON stats to stdout about constraint performance\n\
@@ -61,6 +97,117 @@ acquire team-csv-file constraint-json-file team-name [partition-name]\n\
 ";
 }
 
+// Convert the value of a command line option to a positive integer. Throws an exception
+// if the value is not valid.
+static int positive_integer_option_value(const char* option, const char* value)
+{
+    char* end;
+    long result = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' || result <= 0 || result > INT_MAX) {
+	throw AnnealException("Expected positive integer value for option ", option);
+    }
+    return (int)result;
+}
+
+// As above but 0 is also allowed
+static int non_negative_integer_option_value(const char* option, const char* value)
+{
+    char* end;
+    long result = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' || result < 0 || result > INT_MAX) {
+	throw AnnealException("Expected non-negative integer value for option ", option);
+    }
+    return (int)result;
+}
+
+// Convert the value of a command line option to a non-negative integer (of up to 64 bits).
+// Throws an exception if the value is not valid.
+static unsigned long long unsigned_integer_option_value(const char* option, const char* value)
+{
+    char* end;
+    errno = 0;
+    unsigned long long result = strtoull(value, &end, 10);
+    if(*value < '0' || *value > '9' || *end != '\0' || errno == ERANGE) {
+	throw AnnealException("Expected non-negative integer value for option ", option);
+    }
+    return result;
+}
+
+// Convert the value of a command line option to a non-negative number. Throws an exception
+// if the value is not valid.
+static double non_negative_number_option_value(const char* option, const char* value)
+{
+    char* end;
+    double result = strtod(value, &end);
+    if(*value == '\0' || *end != '\0' || !(result >= 0.0) || isinf(result)) {
+	throw AnnealException("Expected non-negative number value for option ", option);
+    }
+    return result;
+}
+
+// Remove any options (arguments starting with "--") from the argument list and record 
+// them in the given options. argc and argv are updated so that only the program name, 
+// the subcommand and positional arguments remain. Throws an exception if an option is 
+// not valid.
+static void extract_create_options(int& argc, const char* argv[], AnnealOptions& options)
+{
+    int numArgs = 2;	// program name and subcommand are always kept
+    for(int i = 2; i < argc; ++i) {
+	string arg = argv[i];
+	if(arg.compare(0, 2, "--") != 0) {
+	    // Not an option - keep it
+	    argv[numArgs++] = argv[i];
+	} else if(arg == "--pin-threads") {
+	    options.pinThreads = true;
+	} else if(arg == "--cost-guided-swaps") {
+	    options.costGuidedSwaps = true;
+	} else if(i + 1 >= argc) {
+	    // All other options take a value
+	    throw AnnealException("Missing value for option ", argv[i]);
+	} else if(arg == "--jobs") {
+	    options.numJobs = positive_integer_option_value(argv[i], argv[i+1]);
+	    ++i;
+	} else if(arg == "--restarts") {
+	    options.numRestarts = positive_integer_option_value(argv[i], argv[i+1]);
+	    ++i;
+	} else if(arg == "--replicas") {
+	    options.numReplicas = positive_integer_option_value(argv[i], argv[i+1]);
+	    ++i;
+	} else if(arg == "--cooling") {
+	    if(!options.cooling.set_schedule(argv[i+1])) {
+		throw AnnealException("Cooling schedule must be one of 'default','geometric',"
+			"'lundy-mees','lam' not ", argv[i+1]);
+	    }
+	    ++i;
+	} else if(arg == "--reheats") {
+	    options.cooling.maxReheats = non_negative_integer_option_value(argv[i], argv[i+1]);
+	    ++i;
+	} else if(arg == "--time-limit") {
+	    options.timeLimit = non_negative_number_option_value(argv[i], argv[i+1]);
+	    if(options.timeLimit == 0.0) {
+		throw AnnealException("Expected positive value for option ", argv[i]);
+	    }
+	    ++i;
+	} else if(arg == "--max-moves") {
+	    unsigned long long maxMoves = unsigned_integer_option_value(argv[i], argv[i+1]);
+	    if(maxMoves == 0 || maxMoves > LLONG_MAX) {
+		throw AnnealException("Expected positive integer value for option ", argv[i]);
+	    }
+	    options.maxMoves = (long long)maxMoves;
+	    ++i;
+	} else if(arg == "--target-cost") {
+	    options.targetCost = non_negative_number_option_value(argv[i], argv[i+1]);
+	    ++i;
+	} else if(arg == "--seed") {
+	    set_master_random_seed(unsigned_integer_option_value(argv[i], argv[i+1]));
+	    ++i;
+	} else {
+	    throw AnnealException("Unknown option ", argv[i]);
+	}
+    }
+    argc = numArgs;
+}
+
 // Extract data from the files referred to on the command line - argv[2] and argv[3]
 // Create the initial team allocation - either from existing data in the CSV file or 
 // randomly.
@@ -87,17 +234,27 @@ static AllTeamData* set_up_data(AnnealInfo& annealInfo, const char* argv[])
     return new AllTeamData(annealInfo);
 }
 
+// Signal handler for SIGINT and SIGTERM during the anneal - the anneal stops and the lowest
+// cost teams found so far are output. A second signal terminates the program.
+static void stop_anneal_on_signal(int signalNum)
+{
+    request_anneal_stop();
+    signal(signalNum, SIG_DFL);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // create function
 //
 // argv[2] is team csv file
 // argv[3] is constraint file name
 // argv[4] is output csv file name
-static void teamanneal_create(AllTeamData* teamData, const char* argv[])
+static void teamanneal_create(AllTeamData* teamData, const char* argv[], 
+	const AnnealOptions& options)
 {
     // Init stats
     stats_init(argv[2], argv[3], argv[4]);
     // Set up initial "random" teams
+    cerr << "Random seed: " << get_master_random_seed() << endl;
     cerr << "Populating random teams" << endl;
     teamData->populate_random_teams();
     cerr << "Initialising costs" << endl;
@@ -107,11 +264,21 @@ static void teamanneal_create(AllTeamData* teamData, const char* argv[])
     teamData->set_names_for_all_teams();
 
     // Do anneal
+    signal(SIGINT, stop_anneal_on_signal);
+    signal(SIGTERM, stop_anneal_on_signal);
 #ifdef SINGLE_THREAD
-    anneal_all_partitions_single_thread(teamData, allCostData);
+    anneal_all_partitions_single_thread(teamData, allCostData, options);
 #else 
-    anneal_all_partitions(teamData, allCostData);
+    anneal_all_partitions(teamData, allCostData, options);
 #endif
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if(anneal_stop_requested()) {
+	cerr << "Annealing interrupted - outputting the lowest cost teams found" << endl;
+    }
+
+    // Teams may have been replaced during the anneal (e.g. from a restart) - name them again
+    teamData->set_names_for_all_teams();
 
     // Update column names if required and output the result
     teamData->get_anneal_info().update_column_names_if_required();
@@ -205,12 +372,16 @@ int main(int argc, const char* argv[])
 {
     AnnealInfo* annealInfo = new AnnealInfo();
     AllTeamData* teamData;
+    AnnealOptions options;
 
     if(argc < 2) {
 	print_usage_message_and_exit(argv[0]);
     } else {
 	string cmd = argv[1];
 	try {
+	    if(cmd == "create") {
+		extract_create_options(argc, argv, options);
+	    }
 	    if(cmd == "help") {
 		print_help_message(argv[0]);
 	    } else if (argc < 4) {
@@ -218,7 +389,9 @@ int main(int argc, const char* argv[])
 	    } else {
 		if(cmd.compare("create") == 0 && argc == 5) {
 		    teamData = set_up_data(*annealInfo, argv);
-		    teamanneal_create(teamData, argv);
+		    // Command line settings override those in the constraint file
+		    options.cooling.add_defaults_from(annealInfo->get_cooling_options());
+		    teamanneal_create(teamData, argv, options);
 		} else if(cmd.compare("evaluate") == 0 && argc == 4) {
 		    teamData = set_up_data(*annealInfo, argv);
 		    teamanneal_evaluate(teamData, argv);
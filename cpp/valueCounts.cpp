@@ -0,0 +1,131 @@
+//
+// valueCounts.cpp
+//
+
+#include "valueCounts.hh"
+#include "assert.h"
+
+// Constructor
+ValueCounts::ValueCounts() :
+	sparse(false),
+	numEntriesUsed(0),
+	hashShift(32)
+{
+}
+
+void ValueCounts::reset(int numValues, int numMembers)
+{
+    sparse = (numValues > MIN_SPARSE_VALUES && numValues > SPARSE_VALUES_PER_MEMBER * numMembers);
+    if(sparse) {
+	denseCounts.clear();
+	denseCounts.shrink_to_fit();
+	entries.clear();
+	rebuild(numMembers);
+    } else {
+	entries.clear();
+	entries.shrink_to_fit();
+	denseCounts.assign(numValues, 0);
+    }
+}
+
+int ValueCounts::find_entry(int value) const
+{
+    // Fibonacci hashing - the top bits of the product are well mixed
+    unsigned int mask = entries.size() - 1;
+    unsigned int i = ((unsigned int)value * 2654435769u) >> hashShift;
+    while(entries[i].value != value && entries[i].value != -1) {
+	i = (i + 1) & mask;
+    }
+    return i;
+}
+
+int ValueCounts::add_entry(int value)
+{
+    if(2 * (numEntriesUsed + 1) > (int)entries.size()) {
+	// Count the values we really hold - entries with 0 counts can be dropped
+	int numValuesHeld = 1;
+	for(unsigned int i = 0; i < entries.size(); ++i) {
+	    if(entries[i].count > 0) {
+		++numValuesHeld;
+	    }
+	}
+	rebuild(numValuesHeld);
+    }
+    int i = find_entry(value);
+    entries[i].value = value;
+    entries[i].count = 0;
+    ++numEntriesUsed;
+    return i;
+}
+
+void ValueCounts::rebuild(int numValuesHeld)
+{
+    // Allow room to grow before the next rebuild (the table is at most half full)
+    unsigned int size = 8;
+    hashShift = 29;
+    while(size < 4 * (unsigned int)numValuesHeld) {
+	size *= 2;
+	--hashShift;
+    }
+    vector<Entry> oldEntries(size, Entry{-1, 0});
+    oldEntries.swap(entries);
+    numEntriesUsed = 0;
+    for(unsigned int i = 0; i < oldEntries.size(); ++i) {
+	if(oldEntries[i].count > 0) {
+	    int j = find_entry(oldEntries[i].value);
+	    entries[j] = oldEntries[i];
+	    ++numEntriesUsed;
+	}
+    }
+}
+
+int ValueCounts::get(int value) const
+{
+    if(!sparse) {
+	return denseCounts[value];
+    }
+    return entries[find_entry(value)].count;	// an unused entry has a count of 0
+}
+
+void ValueCounts::set(int value, int count)
+{
+    if(!sparse) {
+	denseCounts[value] = count;
+	return;
+    }
+    int i = find_entry(value);
+    if(entries[i].value == -1) {
+	if(count == 0) {
+	    return;
+	}
+	i = add_entry(value);
+    }
+    entries[i].count = count;
+}
+
+int ValueCounts::increment(int value)
+{
+    if(!sparse) {
+	return ++denseCounts[value];
+    }
+    int i = find_entry(value);
+    if(entries[i].value == -1) {
+	i = add_entry(value);
+    }
+    return ++entries[i].count;
+}
+
+int ValueCounts::decrement(int value)
+{
+    if(!sparse) {
+	return --denseCounts[value];
+    }
+    int i = find_entry(value);
+    assert(entries[i].value == value);
+    return --entries[i].count;
+}
+
+bool ValueCounts::is_sparse() const
+{
+    return sparse;
+}
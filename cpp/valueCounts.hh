@@ -0,0 +1,50 @@
+//
+// valueCounts.hh
+//
+
+#ifndef VALUECOUNTS_HH
+#define VALUECOUNTS_HH
+
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// ValueCounts
+
+// Number of members of a team with each value of a string attribute (values are attribute value
+// indices). If the attribute has many more possible values than the team has members (e.g. 
+// postcodes) then the counts are kept in a small hash table so that the memory needed scales with
+// the team size rather than the number of possible values. Otherwise they're indexed directly.
+class ValueCounts {
+private:
+    // Use the hash table if there are more than this many possible values per member (and more
+    // than MIN_SPARSE_VALUES possible values)
+    static const int SPARSE_VALUES_PER_MEMBER = 8;
+    static const int MIN_SPARSE_VALUES = 64;
+    struct Entry {
+	int value;		// -1 if the entry is unused
+	int count;		// may be 0 - such entries are dropped when the table is rebuilt
+    };
+    bool sparse;
+    vector<int> denseCounts;	// indexed by value (if not sparse)
+    vector<Entry> entries;	// open addressed (linear probing) hash table (if sparse) - the
+    				// size is a power of two and at most half the entries are used
+    int numEntriesUsed;
+    int hashShift;		// 32 minus log2 of the table size
+
+    int find_entry(int value) const;	// entry with this value, or the unused entry it would go in
+    int add_entry(int value);		// add an entry for the value (not already present)
+    void rebuild(int numValuesHeld);	// resize table for this many values, dropping 0 counts
+public:
+    ValueCounts();
+    // Set all counts to 0, choosing the representation for a team of the given size
+    void reset(int numValues, int numMembers);
+    int get(int value) const;
+    void set(int value, int count);
+    int increment(int value);	// returns the new count
+    int decrement(int value);	// returns the new count
+    bool is_sparse() const;	// true if the counts are kept in the hash table
+};
+
+#endif
@@ -0,0 +1,103 @@
+//
+// valueCounts_test.cpp
+//
+// Module for testing ValueCounts - random sequences of operations are checked against a map
+
+#include <iostream>
+#include <map>
+#include "valueCounts.hh"
+#include "random.hh"
+using namespace std;
+
+static int numFailures = 0;
+
+static void check(bool ok, const char* what, int numValues, int numMembers, int step)
+{
+    if(!ok) {
+	cerr << "FAILED: " << what << " (" << numValues << " values, " << numMembers <<
+		" members, step " << step << ")" << endl;
+	++numFailures;
+    }
+}
+
+// Every count must match the reference (values not in the reference have a count of 0)
+static void check_all(const ValueCounts& counts, const map<int,int>& reference, int numValues,
+	int numMembers, int step)
+{
+    for(int value = 0; value < numValues; ++value) {
+	map<int,int>::const_iterator itr = reference.find(value);
+	int expected = (itr == reference.end()) ? 0 : itr->second;
+	check(counts.get(value) == expected, "get", numValues, numMembers, step);
+    }
+}
+
+// Apply random increments, decrements and sets to the counts and the reference. Values are
+// drawn from a window which drifts across the possible values so that (when the counts are
+// sparse) many distinct values come and go, forcing the hash table to be rebuilt.
+static void test_random_operations(ValueCounts& counts, int numValues, int numMembers,
+	int numSteps, RandomGenerator& random)
+{
+    counts.reset(numValues, numMembers);
+    check(counts.is_sparse() == (numValues > 64 && numValues > 8 * numMembers), "is_sparse",
+	    numValues, numMembers, 0);
+    map<int,int> reference;
+    int window = min(numValues, 2 * numMembers + 1);
+    for(int step = 1; step <= numSteps; ++step) {
+	int value = (step / 16 + random.uniform_int(window)) % numValues;
+	int& expected = reference[value];
+	int operation = random.uniform_int(8);
+	if(operation < 4) {
+	    check(counts.increment(value) == ++expected, "increment", numValues, numMembers,
+		    step);
+	} else if(operation < 7) {
+	    if(expected > 0) {
+		check(counts.decrement(value) == --expected, "decrement", numValues, numMembers,
+			step);
+	    }
+	} else {
+	    expected = random.uniform_int(4);
+	    counts.set(value, expected);
+	}
+	check(counts.get(value) == expected, "get", numValues, numMembers, step);
+	if(step % 256 == 0) {
+	    check_all(counts, reference, numValues, numMembers, step);
+	}
+    }
+    check_all(counts, reference, numValues, numMembers, numSteps);
+}
+
+int main(int argc, char* argv[])
+{
+    set_master_random_seed(1);
+    RandomGenerator random(RandomGenerator::PARTITION, 0, 0);
+    // Sizes either side of the sparse threshold - the same object is reused so that it is
+    // switched between representations
+    const int numValuesToTest[] = { 1, 10, 64, 65, 72, 73, 500, 5000 };
+    const int numMembersToTest[] = { 0, 1, 2, 8, 9, 100 };
+    ValueCounts counts;
+    for(int numValues : numValuesToTest) {
+	for(int numMembers : numMembersToTest) {
+	    test_random_operations(counts, numValues, numMembers, 4096, random);
+	}
+    }
+
+    // Setting counts of values not held to 0 doesn't add entries - enough of these to fill the
+    // hash table several times over must still leave room for real counts
+    counts.reset(100000, 1);
+    map<int,int> reference;
+    for(int value = 0; value < 1000; ++value) {
+	counts.set(value, 0);
+    }
+    for(int value = 0; value < 1000; value += 7) {
+	check(counts.increment(value) == 1, "increment after zero sets", 100000, 1, value);
+	reference[value] = 1;
+    }
+    check_all(counts, reference, 100000, 1, 1000);
+
+    if(numFailures > 0) {
+	cerr << numFailures << " checks failed" << endl;
+	return 1;
+    }
+    cout << "All ValueCounts checks passed" << endl;
+    return 0;
+}